@@ -0,0 +1,111 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Multi-producer multi-consumer FIFO of a fixed capacity. Push blocks while
+// the queue is full. After Close, pushes fail and pops drain what is left.
+template <typename T>
+class BoundedQueue {
+   public:
+    explicit BoundedQueue(std::size_t capacity) : capacity_(capacity) {}
+
+    // Returns false if the queue is closed
+    bool Push(T value);
+
+    // Moves from value only on success
+    bool TryPush(T &value);
+
+    // Returns nothing once the queue is closed and empty
+    std::optional<T> Pop();
+
+    // Waits for one element, then keeps collecting until max_count elements
+    // are taken or window passes. Empty once the queue is closed and empty.
+    std::vector<T> PopBatch(std::size_t max_count,
+                            std::chrono::microseconds window);
+
+    void Close();
+
+   private:
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<T> items_;
+    const std::size_t capacity_;
+    bool closed_ = false;
+};
+
+template <typename T>
+bool BoundedQueue<T>::Push(T value) {
+    std::unique_lock lock(mutex_);
+    not_full_.wait(lock,
+                   [this] { return closed_ || items_.size() < capacity_; });
+    if (closed_) {
+        return false;
+    }
+    items_.push_back(std::move(value));
+    not_empty_.notify_one();
+    return true;
+}
+
+template <typename T>
+bool BoundedQueue<T>::TryPush(T &value) {
+    std::lock_guard lock(mutex_);
+    if (closed_ || items_.size() >= capacity_) {
+        return false;
+    }
+    items_.push_back(std::move(value));
+    not_empty_.notify_one();
+    return true;
+}
+
+template <typename T>
+std::optional<T> BoundedQueue<T>::Pop() {
+    std::unique_lock lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+        return std::nullopt;
+    }
+    T value = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return value;
+}
+
+template <typename T>
+std::vector<T> BoundedQueue<T>::PopBatch(std::size_t max_count,
+                                         std::chrono::microseconds window) {
+    std::vector<T> batch;
+    std::unique_lock lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    const auto deadline = std::chrono::steady_clock::now() + window;
+    while (batch.size() < max_count) {
+        if (items_.empty()) {
+            if (closed_ ||
+                !not_empty_.wait_until(lock, deadline, [this] {
+                    return closed_ || !items_.empty();
+                }) ||
+                items_.empty()) {
+                break;
+            }
+        }
+        batch.push_back(std::move(items_.front()));
+        items_.pop_front();
+    }
+    not_full_.notify_all();
+    return batch;
+}
+
+template <typename T>
+void BoundedQueue<T>::Close() {
+    std::lock_guard lock(mutex_);
+    closed_ = true;
+    not_empty_.notify_all();
+    not_full_.notify_all();
+}
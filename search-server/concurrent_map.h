@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <future>
 #include <map>
+#include <memory_resource>
 #include <numeric>
 #include <random>
 #include <string>
@@ -28,10 +29,21 @@ public:
 
     void Erase(Key key) {
         std::size_t map_num = key % size_;
-        std::lock_guard(maps_[map_num].m_);
+        std::lock_guard lock(maps_[map_num].m_);
         maps_[map_num].map_.erase(key);
     } 
 
+    // Visits all entries bucket by bucket, not in key order
+    template <typename Function>
+    void ForEach(Function function) {
+        for (auto& safe_map : maps_) {
+            std::lock_guard lock(safe_map.m_);
+            for (auto& k_v : safe_map.map_) {
+                function(k_v);
+            }
+        }
+    }
+
     std::map<Key, Value> BuildOrdinaryMap() {
         std::map<Key, Value> result;
         for (auto& safe_map : maps_) {
@@ -44,9 +56,12 @@ public:
     }
 
 private:
+    // Nodes come from a per-bucket arena guarded by the bucket mutex and
+    // are only freed together with the map
     struct SafeMap {
         std::mutex m_;
-        std::map<Key, Value> map_;
+        std::pmr::monotonic_buffer_resource resource_;
+        std::pmr::map<Key, Value> map_{&resource_};
     };
     std::vector<SafeMap> maps_;
     std::size_t size_;
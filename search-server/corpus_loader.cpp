@@ -0,0 +1,220 @@
+#include "corpus_loader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "document_record.h"
+
+namespace {
+
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string &path) {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) < 0) {
+            const int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), path);
+        }
+        size_ = static_cast<std::size_t>(file_stat.st_size);
+        if (size_ > 0) {
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        const int error = errno;
+        close(fd);
+        if (data_ == MAP_FAILED) {
+            throw std::system_error(error, std::generic_category(), path);
+        }
+        if (size_ > 0) {
+            madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        if (size_ > 0) {
+            munmap(data_, size_);
+        }
+    }
+
+    std::string_view GetText() const {
+        return size_ > 0 ? std::string_view(static_cast<const char *>(data_), size_)
+                         : std::string_view{};
+    }
+
+   private:
+    void *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+struct Chunk {
+    std::size_t sequence;
+    std::string_view text;
+};
+
+struct ParsedDocument {
+    DocumentRecord record;
+    SearchServer::DocumentTerms terms;
+};
+
+struct ParsedChunk {
+    std::size_t sequence;
+    std::vector<ParsedDocument> documents;
+    // Set when a line of the chunk is malformed; documents holds the lines
+    // before it
+    std::exception_ptr error;
+};
+
+void ReadChunks(std::string_view text, std::size_t chunk_size,
+                BoundedQueue<Chunk> &chunks) {
+    std::size_t sequence = 0;
+    while (!text.empty()) {
+        std::size_t end = std::min(chunk_size, text.size());
+        end = std::min(text.find('\n', end), text.size());
+        end = std::min(end + 1, text.size());
+        // Prefetching the next chunk overlaps page faults with tokenizing
+        const std::string_view next = text.substr(end);
+        if (!next.empty()) {
+            const auto page_size = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+            const auto address = reinterpret_cast<std::uintptr_t>(next.data());
+            const std::uintptr_t page = address & ~(page_size - 1);
+            madvise(reinterpret_cast<void *>(page),
+                    std::min(chunk_size, next.size()) + (address - page),
+                    MADV_WILLNEED);
+        }
+        if (!chunks.Push({sequence++, text.substr(0, end)})) {
+            return;
+        }
+        text = next;
+    }
+}
+
+ParsedChunk TokenizeChunk(const SearchServer &search_server, const Chunk &chunk) {
+    ParsedChunk parsed{chunk.sequence, {}, nullptr};
+    std::string_view text = chunk.text;
+    try {
+        while (!text.empty()) {
+            const std::size_t end = std::min(text.find('\n'), text.size());
+            std::string_view line = text.substr(0, end);
+            text.remove_prefix(std::min(end + 1, text.size()));
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (line.empty()) {
+                continue;
+            }
+            ParsedDocument document;
+            document.record = ParseDocumentRecord(line);
+            document.terms = search_server.TokenizeDocument(document.record.text);
+            parsed.documents.push_back(std::move(document));
+        }
+    } catch (...) {
+        parsed.error = std::current_exception();
+    }
+    return parsed;
+}
+
+}  // namespace
+
+double CorpusLoadStats::GetMegabytesPerSecond() const {
+    return elapsed.count() > 0 ? byte_count / (1024.0 * 1024.0) / elapsed.count()
+                               : 0.0;
+}
+
+double CorpusLoadStats::GetDocumentsPerSecond() const {
+    return elapsed.count() > 0 ? document_count / elapsed.count() : 0.0;
+}
+
+CorpusLoadStats LoadCorpus(SearchServer &search_server, const std::string &path,
+                           const CorpusLoaderOptions &options) {
+    const auto start = std::chrono::steady_clock::now();
+    const MappedFile file(path);
+    const std::string_view text = file.GetText();
+
+    std::size_t tokenizer_count = options.tokenizer_thread_count;
+    if (tokenizer_count == 0) {
+        tokenizer_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    BoundedQueue<Chunk> chunks(options.queue_capacity);
+    BoundedQueue<ParsedChunk> parsed_chunks(options.queue_capacity);
+    std::atomic<std::size_t> running_tokenizers{tokenizer_count};
+
+    std::vector<std::thread> threads;
+    threads.emplace_back([text, &options, &chunks] {
+        ReadChunks(text, std::max<std::size_t>(options.chunk_size, 1), chunks);
+        chunks.Close();
+    });
+    for (std::size_t i = 0; i < tokenizer_count; ++i) {
+        threads.emplace_back([&search_server, &chunks, &parsed_chunks,
+                              &running_tokenizers] {
+            while (const auto chunk = chunks.Pop()) {
+                if (!parsed_chunks.Push(TokenizeChunk(search_server, *chunk))) {
+                    break;
+                }
+            }
+            if (--running_tokenizers == 0) {
+                parsed_chunks.Close();
+            }
+        });
+    }
+    // Closing both queues lets every stage finish early
+    const auto stop_pipeline = [&] {
+        chunks.Close();
+        parsed_chunks.Close();
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    };
+
+    CorpusLoadStats stats;
+    stats.byte_count = text.size();
+    try {
+        // Chunks arrive out of order; they are indexed in file order
+        std::map<std::size_t, ParsedChunk> waiting_chunks;
+        std::size_t next_sequence = 0;
+        while (auto parsed_chunk = parsed_chunks.Pop()) {
+            waiting_chunks.emplace(parsed_chunk->sequence, std::move(*parsed_chunk));
+            for (auto it = waiting_chunks.begin();
+                 it != waiting_chunks.end() && it->first == next_sequence;
+                 it = waiting_chunks.erase(it), ++next_sequence) {
+                for (const ParsedDocument &document : it->second.documents) {
+                    search_server.AddDocument(document.record.id, document.terms,
+                                              document.record.status,
+                                              document.record.ratings);
+                    ++stats.document_count;
+                }
+                if (it->second.error) {
+                    std::rethrow_exception(it->second.error);
+                }
+            }
+        }
+    } catch (...) {
+        stop_pipeline();
+        throw;
+    }
+    stop_pipeline();
+    stats.elapsed = std::chrono::steady_clock::now() - start;
+    return stats;
+}
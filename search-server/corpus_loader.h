@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+#include "search_server.h"
+
+struct CorpusLoaderOptions {
+    // 0 uses one thread per hardware thread
+    std::size_t tokenizer_thread_count = 0;
+    // The file is handed to tokenizers in pieces of about this many bytes,
+    // cut at line ends
+    std::size_t chunk_size = 1 << 20;
+    // Chunks waiting between two stages
+    std::size_t queue_capacity = 16;
+};
+
+struct CorpusLoadStats {
+    std::size_t document_count = 0;
+    std::size_t byte_count = 0;
+    std::chrono::duration<double> elapsed{0};
+
+    double GetMegabytesPerSecond() const;
+    double GetDocumentsPerSecond() const;
+};
+
+// Adds every line of a corpus file to search_server, in file order. Lines
+// are DocumentRecord texts; empty lines are skipped. The file is memory
+// mapped and goes through a read -> tokenize -> index pipeline: one
+// thread cuts the mapping into chunks, tokenizer threads parse and
+// tokenize chunks in parallel, and the calling thread indexes them.
+//
+// A malformed line or a failed AddDocument stops the load with
+// std::invalid_argument; documents of earlier lines stay added.
+CorpusLoadStats LoadCorpus(SearchServer &search_server, const std::string &path,
+                           const CorpusLoaderOptions &options = {});
@@ -0,0 +1,35 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "corpus_loader.h"
+#include "search_server.h"
+
+// Usage: corpus_loader <corpus_file> [tokenizer_threads] ["stop words"]
+// Loads the file into an in-memory index and reports the load throughput.
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: "s << argv[0]
+                  << " <corpus_file> [tokenizer_threads] [\"stop words\"]"s
+                  << std::endl;
+        return 1;
+    }
+    CorpusLoaderOptions options;
+    if (argc > 2) {
+        options.tokenizer_thread_count = static_cast<std::size_t>(std::atoi(argv[2]));
+    }
+    SearchServer search_server(argc > 3 ? std::string(argv[3]) : ""s);
+    try {
+        const CorpusLoadStats stats = LoadCorpus(search_server, argv[1], options);
+        std::cout << "documents: "s << stats.document_count << ", MB: "s
+                  << stats.byte_count / (1024.0 * 1024.0) << ", seconds: "s
+                  << stats.elapsed.count() << '\n'
+                  << "MB/s: "s << stats.GetMegabytesPerSecond()
+                  << ", documents/s: "s << stats.GetDocumentsPerSecond()
+                  << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include "corpus_stats.h"
+
+#include <algorithm>
+
+CorpusStats &CorpusStats::operator+=(const CorpusStats &other) {
+    document_count += other.document_count;
+    for (const auto &[word, document_freq] : other.document_freqs) {
+        document_freqs[word] += document_freq;
+    }
+    // Merged expansions are left uncapped, the servers cap them
+    for (const auto &[term, matches] : other.word_expansions) {
+        std::vector<WordMatch> &merged = word_expansions[term];
+        merged.insert(merged.end(), matches.begin(), matches.end());
+        std::sort(merged.begin(), merged.end(),
+                  [](const WordMatch &lhs, const WordMatch &rhs) {
+                      return lhs.distance != rhs.distance
+                                 ? lhs.distance < rhs.distance
+                                 : lhs.word < rhs.word;
+                  });
+        merged.erase(std::unique(merged.begin(), merged.end(),
+                                 [](const WordMatch &lhs, const WordMatch &rhs) {
+                                     return lhs.word == rhs.word;
+                                 }),
+                     merged.end());
+    }
+    return *this;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "term_trie.h"
+
+// Document count and per-word document frequencies over a whole corpus.
+// Lets a server holding part of the corpus score with corpus-wide IDF.
+struct CorpusStats {
+    int document_count = 0;
+    std::map<std::string, int, std::less<>> document_freqs;
+
+    // Words each word* and word~N term of the query expands to, closest
+    // first, keyed by the term without its sign: pre* or pre~1
+    using WordExpansions =
+        std::map<std::string, std::vector<WordMatch>, std::less<>>;
+    WordExpansions word_expansions;
+
+    CorpusStats &operator+=(const CorpusStats &other);
+};
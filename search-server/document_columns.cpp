@@ -0,0 +1,77 @@
+#include "document_columns.h"
+
+#include <utility>
+
+DocumentColumns::DocumentColumns(std::pmr::memory_resource *resource)
+    : ids_(resource),
+      statuses_(resource),
+      ratings_(resource),
+      status_bitmaps_{Bitmap(resource), Bitmap(resource), Bitmap(resource),
+                      Bitmap(resource)} {}
+
+std::uint32_t DocumentColumns::Add(int document_id, DocumentStatus status,
+                                   int rating) {
+    const auto index = static_cast<std::uint32_t>(ids_.size());
+    ids_.push_back(document_id);
+    statuses_.push_back(status);
+    ratings_.push_back(rating);
+    if (index % 64 == 0) {
+        for (Bitmap &bitmap : status_bitmaps_) {
+            bitmap.push_back(0);
+        }
+    }
+    status_bitmaps_[static_cast<std::size_t>(status)][index / 64] |=
+        std::uint64_t{1} << (index % 64);
+    return index;
+}
+
+void DocumentColumns::Remove(std::uint32_t index) {
+    status_bitmaps_[static_cast<std::size_t>(statuses_[index])][index / 64] &=
+        ~(std::uint64_t{1} << (index % 64));
+}
+
+std::size_t DocumentColumns::GetSize() const { return ids_.size(); }
+
+bool DocumentColumns::IsAlive(std::uint32_t index) const {
+    return TestBit(GetStatusBitmap(statuses_[index]), index);
+}
+
+const Bitmap &DocumentColumns::GetStatusBitmap(DocumentStatus status) const {
+    return status_bitmaps_[static_cast<std::size_t>(status)];
+}
+
+std::vector<std::uint32_t> DocumentColumns::GetCompactIndices() const {
+    std::vector<std::uint32_t> new_indices(GetSize(), DEAD_DOCUMENT_INDEX);
+    std::uint32_t next_index = 0;
+    for (std::uint32_t index = 0; index < GetSize(); ++index) {
+        if (IsAlive(index)) {
+            new_indices[index] = next_index++;
+        }
+    }
+    return new_indices;
+}
+
+void DocumentColumns::Compact(const std::vector<std::uint32_t> &new_indices) {
+    DocumentColumns compacted(ids_.get_allocator().resource());
+    for (std::uint32_t index = 0; index < GetSize(); ++index) {
+        if (new_indices[index] == DEAD_DOCUMENT_INDEX) {
+            continue;
+        }
+        const std::uint32_t new_index =
+            compacted.Add(ids_[index], statuses_[index], ratings_[index]);
+        if (!IsAlive(index)) {
+            compacted.Remove(new_index);
+        }
+    }
+    *this = std::move(compacted);
+}
+
+std::size_t DocumentColumns::GetMemoryBytes() const {
+    std::size_t bytes = ids_.capacity() * sizeof(int) +
+                        statuses_.capacity() * sizeof(DocumentStatus) +
+                        ratings_.capacity() * sizeof(int);
+    for (const Bitmap &bitmap : status_bitmaps_) {
+        bytes += bitmap.capacity() * sizeof(std::uint64_t);
+    }
+    return bytes;
+}
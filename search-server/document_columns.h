@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "document.h"
+#include "posting_list.h"
+
+constexpr std::size_t DOCUMENT_STATUS_COUNT = 4;
+
+using Bitmap = std::pmr::vector<std::uint64_t>;
+
+inline bool TestBit(const Bitmap &bitmap, std::uint32_t index) {
+    return (bitmap[index / 64] >> (index % 64)) & 1;
+}
+
+// Document attributes stored by internal document index, one column per
+// attribute, plus a bitmap of live documents for every status.
+class DocumentColumns {
+   public:
+    explicit DocumentColumns(std::pmr::memory_resource *resource =
+                                 std::pmr::get_default_resource());
+
+    // Returns the internal index of the new document
+    std::uint32_t Add(int document_id, DocumentStatus status, int rating);
+
+    void Remove(std::uint32_t index);
+
+    // Number of indices ever assigned, removed ones included
+    std::size_t GetSize() const;
+
+    bool IsAlive(std::uint32_t index) const;
+
+    int GetId(std::uint32_t index) const { return ids_[index]; }
+
+    DocumentStatus GetStatus(std::uint32_t index) const {
+        return statuses_[index];
+    }
+
+    int GetRating(std::uint32_t index) const { return ratings_[index]; }
+
+    const Bitmap &GetStatusBitmap(DocumentStatus status) const;
+
+    // Old to new index mapping that drops the removed documents,
+    // DEAD_DOCUMENT_INDEX for them. Live documents keep their relative
+    // order.
+    std::vector<std::uint32_t> GetCompactIndices() const;
+
+    // Moves every document to new_indices[index], dropping those mapped to
+    // DEAD_DOCUMENT_INDEX. The mapping must preserve order and number the
+    // kept documents from 0 without gaps; removed documents may be kept.
+    void Compact(const std::vector<std::uint32_t> &new_indices);
+
+    std::size_t GetMemoryBytes() const;
+
+   private:
+    std::pmr::vector<int> ids_;
+    std::pmr::vector<DocumentStatus> statuses_;
+    std::pmr::vector<int> ratings_;
+    std::array<Bitmap, DOCUMENT_STATUS_COUNT> status_bitmaps_;
+};
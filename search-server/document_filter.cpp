@@ -0,0 +1,35 @@
+#include "document_filter.h"
+
+DocumentFilter::DocumentFilter(DocumentStatus status) : statuses{status} {}
+
+CompiledFilter::CompiledFilter(const DocumentFilter &filter,
+                               const DocumentColumns &columns,
+                               std::pmr::memory_resource *resource)
+    : columns_(columns),
+      merged_bitmap_(resource),
+      check_rating_(filter.min_rating != INT_MIN ||
+                    filter.max_rating != INT_MAX),
+      check_document_id_(filter.min_document_id > 0 ||
+                         filter.max_document_id != INT_MAX),
+      min_rating_(filter.min_rating),
+      max_rating_(filter.max_rating),
+      min_document_id_(filter.min_document_id),
+      max_document_id_(filter.max_document_id) {
+    if (filter.statuses.size() == 1) {
+        status_bitmap_ = &columns.GetStatusBitmap(filter.statuses.front());
+        return;
+    }
+    std::vector<DocumentStatus> statuses = filter.statuses;
+    if (statuses.empty()) {
+        statuses = {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT,
+                    DocumentStatus::BANNED, DocumentStatus::REMOVED};
+    }
+    merged_bitmap_.assign(columns.GetStatusBitmap(statuses.front()).size(), 0);
+    for (const DocumentStatus status : statuses) {
+        const Bitmap &bitmap = columns.GetStatusBitmap(status);
+        for (std::size_t i = 0; i < bitmap.size(); ++i) {
+            merged_bitmap_[i] |= bitmap[i];
+        }
+    }
+    status_bitmap_ = &merged_bitmap_;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "document.h"
+#include "document_columns.h"
+
+// Declarative alternative to a DocumentPredicate. Empty statuses accept
+// any status, rating and id bounds are inclusive.
+struct DocumentFilter {
+    DocumentFilter() = default;
+
+    explicit DocumentFilter(DocumentStatus status);
+
+    std::vector<DocumentStatus> statuses;
+    int min_rating = INT_MIN;
+    int max_rating = INT_MAX;
+    int min_document_id = 0;
+    int max_document_id = INT_MAX;
+};
+
+// DocumentFilter turned into a status bitmap test plus the range checks
+// that are actually restricting.
+class CompiledFilter {
+   public:
+    // resource backs the merged bitmap of a multi-status filter
+    CompiledFilter(const DocumentFilter &filter, const DocumentColumns &columns,
+                   std::pmr::memory_resource *resource =
+                       std::pmr::get_default_resource());
+
+    CompiledFilter(const CompiledFilter &) = delete;
+    CompiledFilter &operator=(const CompiledFilter &) = delete;
+
+    bool Accepts(std::uint32_t index) const {
+        if (!TestBit(*status_bitmap_, index)) {
+            return false;
+        }
+        if (check_rating_) {
+            const int rating = columns_.GetRating(index);
+            if (rating < min_rating_ || rating > max_rating_) {
+                return false;
+            }
+        }
+        if (check_document_id_) {
+            const int document_id = columns_.GetId(index);
+            if (document_id < min_document_id_ ||
+                document_id > max_document_id_) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+   private:
+    const DocumentColumns &columns_;
+    Bitmap merged_bitmap_;
+    const Bitmap *status_bitmap_;
+    bool check_rating_;
+    bool check_document_id_;
+    int min_rating_;
+    int max_rating_;
+    int min_document_id_;
+    int max_document_id_;
+};
@@ -0,0 +1,44 @@
+#include "document_record.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "string_processing.h"
+
+using namespace std::literals;
+
+namespace {
+
+DocumentStatus ParseStatus(const std::string_view text) {
+    const int status = ParseInt(text);
+    if (status < static_cast<int>(DocumentStatus::ACTUAL) ||
+        status > static_cast<int>(DocumentStatus::REMOVED)) {
+        throw std::invalid_argument("Invalid document status"s);
+    }
+    return static_cast<DocumentStatus>(status);
+}
+
+std::vector<int> ParseRatings(std::string_view text) {
+    std::vector<int> ratings;
+    if (text == "-"sv) {
+        return ratings;
+    }
+    while (!text.empty()) {
+        const auto end = std::min(text.find(','), text.size());
+        ratings.push_back(ParseInt(text.substr(0, end)));
+        text.remove_prefix(std::min(end + 1, text.size()));
+    }
+    return ratings;
+}
+
+}  // namespace
+
+DocumentRecord ParseDocumentRecord(std::string_view line) {
+    DocumentRecord record;
+    record.id = ParseInt(TakeWord(line));
+    record.status = ParseStatus(TakeWord(line));
+    record.ratings = ParseRatings(TakeWord(line));
+    record.text = TrimLeft(line);
+    return record;
+}
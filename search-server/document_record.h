@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+// Text form of a document, shared by the QueryServer ADD request and
+// corpus files:
+//   <document_id> <status> <ratings> <text>
+// status is the number of a DocumentStatus, ratings are comma-separated
+// or "-" for none. text views the parsed line.
+struct DocumentRecord {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+// Throws std::invalid_argument on a malformed record
+DocumentRecord ParseDocumentRecord(std::string_view line);
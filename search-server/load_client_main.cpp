@@ -0,0 +1,191 @@
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+// Usage: load_client <host> <port> <connections> <seconds> <queries_file>
+// Each connection is a closed loop sending one SEARCH line of the file after
+// another and waiting for its answer. Prints throughput and latency
+// percentiles over all connections.
+namespace {
+
+int Connect(const std::string &host, const std::string &port) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo *address = addresses; address != nullptr;
+         address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype,
+                    address->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addresses);
+    if (fd >= 0) {
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    }
+    return fd;
+}
+
+bool SendAll(int fd, const std::string &data) {
+    std::size_t sent = 0;
+    while (sent < data.size()) {
+        const ssize_t size =
+            send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (size <= 0) {
+            return false;
+        }
+        sent += static_cast<std::size_t>(size);
+    }
+    return true;
+}
+
+// Reads one response line, keeping whatever follows it in buffer
+bool ReceiveLine(int fd, std::string &buffer, std::string &line) {
+    std::size_t end;
+    while ((end = buffer.find('\n')) == std::string::npos) {
+        char chunk[4096];
+        const ssize_t size = recv(fd, chunk, sizeof(chunk), 0);
+        if (size <= 0) {
+            return false;
+        }
+        buffer.append(chunk, static_cast<std::size_t>(size));
+    }
+    line.assign(buffer, 0, end);
+    buffer.erase(0, end + 1);
+    return true;
+}
+
+struct ConnectionStats {
+    std::vector<std::int64_t> latencies_us;
+    std::size_t errors = 0;
+};
+
+ConnectionStats RunConnection(const std::string &host, const std::string &port,
+                              const std::vector<std::string> &queries,
+                              std::size_t first_query,
+                              std::chrono::steady_clock::time_point deadline) {
+    ConnectionStats stats;
+    const int fd = Connect(host, port);
+    if (fd < 0) {
+        ++stats.errors;
+        return stats;
+    }
+    std::string buffer;
+    std::string response;
+    for (std::size_t i = first_query; std::chrono::steady_clock::now() < deadline;
+         ++i) {
+        const std::string request = "SEARCH "s + queries[i % queries.size()] + '\n';
+        const auto start = std::chrono::steady_clock::now();
+        if (!SendAll(fd, request) || !ReceiveLine(fd, buffer, response)) {
+            ++stats.errors;
+            break;
+        }
+        stats.latencies_us.push_back(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count());
+        if (response.compare(0, 2, "OK"sv) != 0) {
+            ++stats.errors;
+        }
+    }
+    close(fd);
+    return stats;
+}
+
+std::int64_t Percentile(const std::vector<std::int64_t> &sorted, double share) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const auto rank = static_cast<std::size_t>(share * (sorted.size() - 1));
+    return sorted[rank];
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc != 6) {
+        std::cerr << "Usage: "s << argv[0]
+                  << " <host> <port> <connections> <seconds> <queries_file>"s
+                  << std::endl;
+        return 1;
+    }
+    const std::string host = argv[1];
+    const std::string port = argv[2];
+    const int connection_count = std::max(1, std::atoi(argv[3]));
+    const int seconds = std::max(1, std::atoi(argv[4]));
+
+    std::vector<std::string> queries;
+    std::ifstream queries_file(argv[5]);
+    for (std::string query; std::getline(queries_file, query);) {
+        if (!query.empty()) {
+            queries.push_back(std::move(query));
+        }
+    }
+    if (queries.empty()) {
+        std::cerr << "No queries in "s << argv[5] << std::endl;
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::seconds(seconds);
+    std::vector<ConnectionStats> stats(connection_count);
+    std::vector<std::thread> threads;
+    for (int connection = 0; connection < connection_count; ++connection) {
+        threads.emplace_back([&, connection] {
+            stats[connection] =
+                RunConnection(host, port, queries,
+                              connection * queries.size() / connection_count,
+                              deadline);
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    const double elapsed = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+
+    std::vector<std::int64_t> latencies;
+    std::size_t errors = 0;
+    for (const ConnectionStats &connection_stats : stats) {
+        latencies.insert(latencies.end(), connection_stats.latencies_us.begin(),
+                         connection_stats.latencies_us.end());
+        errors += connection_stats.errors;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "requests: "s << latencies.size() << ", errors: "s << errors
+              << '\n'
+              << "QPS: "s << static_cast<std::int64_t>(latencies.size() / elapsed)
+              << '\n'
+              << "p50: "s << Percentile(latencies, 0.50) << " us, p99: "s
+              << Percentile(latencies, 0.99) << " us"s << std::endl;
+    return errors == 0 ? 0 : 2;
+}
@@ -1,10 +1,12 @@
 #include "process_queries.h"
 #include "search_server.h"
+#include "test_example_functions.h"
 #include <execution>
 #include <iostream>
 #include <string>
 #include <vector>
 int main() {
+    TestSearchServer();
     SearchServer search_server("and with"s);
     int id = 0;
     for (
@@ -0,0 +1,8 @@
+#include "memory_stats.h"
+
+MemoryUsage &MemoryUsage::operator+=(const MemoryUsage &other) {
+    entries += other.entries;
+    nested_entries += other.nested_entries;
+    bytes += other.bytes;
+    return *this;
+}
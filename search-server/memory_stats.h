@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Byte counts are estimates for libstdc++/libc++ on 64-bit targets:
+// container nodes and heap buffers, without allocator headers.
+struct MemoryUsage {
+    // Top-level elements of the structure
+    std::size_t entries = 0;
+    // Elements of nested containers (postings for per-word maps)
+    std::size_t nested_entries = 0;
+    std::size_t bytes = 0;
+
+    MemoryUsage &operator+=(const MemoryUsage &other);
+};
+
+struct IndexMemoryStats {
+    // Both may be shared with other servers and are counted in full
+    MemoryUsage stop_words;
+    MemoryUsage words;
+    MemoryUsage word_to_document_freqs;
+    MemoryUsage word_to_postings;
+    MemoryUsage documents_words_freqs;
+    MemoryUsage documents;
+    MemoryUsage total;
+    // What Compact() would reclaim
+    std::size_t empty_posting_lists = 0;
+    std::size_t dead_document_indices = 0;
+    std::size_t posting_tombstones = 0;
+};
+
+// Red-black tree node header: color and three pointers
+constexpr std::size_t TREE_NODE_OVERHEAD = 4 * sizeof(void *);
+
+template <typename Container>
+std::size_t EstimateNodeBytes(const Container &container) {
+    return container.size() *
+           (TREE_NODE_OVERHEAD + sizeof(typename Container::value_type));
+}
+
+// Heap buffer of a string, zero while it fits the small-string buffer
+template <typename String>
+std::size_t EstimateHeapBytes(const String &str) {
+    const std::size_t inline_capacity = String{}.capacity();
+    return str.capacity() > inline_capacity ? str.capacity() + 1 : 0;
+}
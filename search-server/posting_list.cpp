@@ -0,0 +1,152 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "scoring_kernels.h"
+
+PostingList::PostingList(const allocator_type &allocator)
+    : document_indices_(allocator), term_freqs_(allocator), impacts_(allocator) {}
+
+PostingList::PostingList(const PostingList &other,
+                         const allocator_type &allocator)
+    : document_indices_(other.document_indices_, allocator),
+      term_freqs_(other.term_freqs_, allocator),
+      impacts_(other.impacts_, allocator),
+      max_impact_(other.max_impact_),
+      has_impacts_(other.has_impacts_),
+      tombstone_count_(other.tombstone_count_) {}
+
+PostingList::PostingList(PostingList &&other, const allocator_type &allocator)
+    : document_indices_(std::move(other.document_indices_), allocator),
+      term_freqs_(std::move(other.term_freqs_), allocator),
+      impacts_(std::move(other.impacts_), allocator),
+      max_impact_(other.max_impact_),
+      has_impacts_(other.has_impacts_),
+      tombstone_count_(other.tombstone_count_) {}
+
+void PostingList::Add(std::uint32_t document_index, double term_freq,
+                      std::uint32_t impact) {
+    max_impact_ = std::max(max_impact_, impact);
+    if (document_indices_.empty() || document_indices_.back() < document_index) {
+        document_indices_.push_back(document_index);
+        term_freqs_.push_back(term_freq);
+        if (has_impacts_) {
+            impacts_.push_back(impact);
+        }
+        return;
+    }
+    const auto it = std::lower_bound(document_indices_.begin(),
+                                     document_indices_.end(), document_index);
+    const auto position = it - document_indices_.begin();
+    if (it != document_indices_.end() && *it == document_index) {
+        term_freqs_[position] += term_freq;
+        if (has_impacts_) {
+            impacts_[position] += impact;
+            max_impact_ = std::max(max_impact_, impacts_[position]);
+        }
+        return;
+    }
+    document_indices_.insert(it, document_index);
+    term_freqs_.insert(term_freqs_.begin() + position, term_freq);
+    if (has_impacts_) {
+        impacts_.insert(impacts_.begin() + position, impact);
+    }
+}
+
+void PostingList::Remove(std::uint32_t document_index) {
+    if (Contains(document_index)) {
+        ++tombstone_count_;
+    }
+}
+
+bool PostingList::Contains(std::uint32_t document_index) const {
+    return std::binary_search(document_indices_.begin(),
+                              document_indices_.end(), document_index);
+}
+
+std::size_t PostingList::Seek(std::uint32_t document_index,
+                              std::size_t from) const {
+    const std::size_t size = document_indices_.size();
+    // Every posting before from is known to be smaller
+    std::size_t bound = from;
+    for (std::size_t step = 1;
+         bound < size && document_indices_[bound] < document_index; step *= 2) {
+        from = bound + 1;
+        bound += step;
+    }
+    const auto begin = document_indices_.begin();
+    return std::lower_bound(begin + from, begin + std::min(bound, size),
+                            document_index) -
+           begin;
+}
+
+std::size_t PostingList::GetSize() const {
+    return document_indices_.size() - tombstone_count_;
+}
+
+bool PostingList::IsEmpty() const { return GetSize() == 0; }
+
+std::size_t PostingList::GetTombstoneCount() const { return tombstone_count_; }
+
+std::size_t PostingList::GetBlockCount() const {
+    return (document_indices_.size() + POSTING_BLOCK_SIZE - 1) /
+           POSTING_BLOCK_SIZE;
+}
+
+PostingBlock PostingList::GetBlock(std::size_t block) const {
+    const std::size_t begin = block * POSTING_BLOCK_SIZE;
+    const std::size_t size =
+        std::min(POSTING_BLOCK_SIZE, document_indices_.size() - begin);
+    return {document_indices_.data() + begin, term_freqs_.data() + begin,
+            has_impacts_ ? impacts_.data() + begin : nullptr, size};
+}
+
+const std::pmr::vector<std::uint32_t> &PostingList::GetDocumentIndices() const {
+    return document_indices_;
+}
+
+const std::pmr::vector<double> &PostingList::GetTermFreqs() const {
+    return term_freqs_;
+}
+
+void PostingList::SetImpacts(double inverse_document_freq) {
+    impacts_.resize(term_freqs_.size());
+    std::transform(term_freqs_.begin(), term_freqs_.end(), impacts_.begin(),
+                   [inverse_document_freq](double term_freq) {
+                       return QuantizeImpact(term_freq * inverse_document_freq);
+                   });
+    max_impact_ = impacts_.empty()
+                      ? 0
+                      : *std::max_element(impacts_.begin(), impacts_.end());
+    has_impacts_ = true;
+}
+
+void PostingList::ClearImpacts() {
+    impacts_.clear();
+    impacts_.shrink_to_fit();
+    max_impact_ = 0;
+    has_impacts_ = false;
+}
+
+bool PostingList::HasImpacts() const { return has_impacts_; }
+
+const std::pmr::vector<std::uint32_t> &PostingList::GetImpacts() const {
+    return impacts_;
+}
+
+std::uint32_t PostingList::GetMaxImpact() const { return max_impact_; }
+
+void PostingList::ShrinkToFit() {
+    if (document_indices_.capacity() > 2 * document_indices_.size()) {
+        document_indices_.shrink_to_fit();
+        term_freqs_.shrink_to_fit();
+        impacts_.shrink_to_fit();
+    }
+}
+
+std::size_t PostingList::GetMemoryBytes() const {
+    return document_indices_.capacity() * sizeof(std::uint32_t) +
+           term_freqs_.capacity() * sizeof(double) +
+           impacts_.capacity() * sizeof(std::uint32_t);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// Postings are scored POSTING_BLOCK_SIZE entries at a time
+constexpr std::size_t POSTING_BLOCK_SIZE = 128;
+
+constexpr std::uint32_t DEAD_DOCUMENT_INDEX = UINT32_MAX;
+
+struct PostingBlock {
+    const std::uint32_t *document_indices;
+    const double *term_freqs;
+    // Null unless the list keeps impacts
+    const std::uint32_t *impacts;
+    std::size_t size;
+};
+
+// Postings of one word in structure-of-arrays layout: internal document
+// indices and term frequencies in two parallel arrays sorted by index.
+// Optionally a third array holds quantized tf-idf impacts, see
+// QuantizeImpact. Removed documents leave tombstones: their postings stay
+// in the arrays, and scorers skip them by the document's liveness, until
+// Renumber drops them.
+class PostingList {
+   public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    PostingList() = default;
+
+    explicit PostingList(const allocator_type &allocator);
+
+    PostingList(const PostingList &other, const allocator_type &allocator);
+
+    PostingList(PostingList &&other, const allocator_type &allocator);
+
+    PostingList(const PostingList &other) = default;
+
+    PostingList(PostingList &&other) = default;
+
+    PostingList &operator=(const PostingList &other) = default;
+
+    PostingList &operator=(PostingList &&other) = default;
+
+    // Appends when document_index is the largest so far, inserts otherwise.
+    // impact is stored only while the list keeps impacts.
+    void Add(std::uint32_t document_index, double term_freq,
+             std::uint32_t impact = 0);
+
+    // Leaves a tombstone in O(log size); called once per removed document
+    void Remove(std::uint32_t document_index);
+
+    // Tombstones included
+    bool Contains(std::uint32_t document_index) const;
+
+    // Position of the first posting with an index not less than
+    // document_index, looking at positions from `from` on. Gallops, so a
+    // run of seeks for increasing indices costs O(log gap) each.
+    std::size_t Seek(std::uint32_t document_index, std::size_t from) const;
+
+    // Live postings, tombstones excluded
+    std::size_t GetSize() const;
+
+    bool IsEmpty() const;
+
+    std::size_t GetTombstoneCount() const;
+
+    std::size_t GetBlockCount() const;
+
+    PostingBlock GetBlock(std::size_t block) const;
+
+    const std::pmr::vector<std::uint32_t> &GetDocumentIndices() const;
+
+    const std::pmr::vector<double> &GetTermFreqs() const;
+
+    // Starts keeping impacts, quantized term_freq * inverse_document_freq
+    void SetImpacts(double inverse_document_freq);
+
+    void ClearImpacts();
+
+    bool HasImpacts() const;
+
+    const std::pmr::vector<std::uint32_t> &GetImpacts() const;
+
+    // Not lowered by Remove, so only an upper bound
+    std::uint32_t GetMaxImpact() const;
+
+    // Maps every index through new_index, dropping the postings mapped to
+    // DEAD_DOCUMENT_INDEX. The mapping must preserve order and drop every
+    // tombstone.
+    template <typename IndexMapping>
+    void Renumber(IndexMapping new_index);
+
+    // Releases capacity once it is more than twice the size
+    void ShrinkToFit();
+
+    std::size_t GetMemoryBytes() const;
+
+   private:
+    std::pmr::vector<std::uint32_t> document_indices_;
+    std::pmr::vector<double> term_freqs_;
+    std::pmr::vector<std::uint32_t> impacts_;
+    std::uint32_t max_impact_ = 0;
+    bool has_impacts_ = false;
+    std::size_t tombstone_count_ = 0;
+};
+
+template <typename IndexMapping>
+void PostingList::Renumber(IndexMapping new_index) {
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < document_indices_.size(); ++i) {
+        const std::uint32_t index = new_index(document_indices_[i]);
+        if (index == DEAD_DOCUMENT_INDEX) {
+            continue;
+        }
+        document_indices_[kept] = index;
+        term_freqs_[kept] = term_freqs_[i];
+        if (has_impacts_) {
+            impacts_[kept] = impacts_[i];
+        }
+        ++kept;
+    }
+    document_indices_.resize(kept);
+    term_freqs_.resize(kept);
+    if (has_impacts_) {
+        impacts_.resize(kept);
+    }
+    tombstone_count_ = 0;
+}
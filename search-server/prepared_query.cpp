@@ -0,0 +1,5 @@
+#include "prepared_query.h"
+
+const std::string &PreparedQuery::GetRawQuery() const { return raw_query_; }
+
+std::uint64_t PreparedQuery::GetGeneration() const { return generation_; }
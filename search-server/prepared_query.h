@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "posting_list.h"
+
+class SearchServer;
+
+// Query parsed once by SearchServer::Prepare: keeps the indexed words,
+// pointers to their postings and precomputed IDF. Valid while the
+// server's index generation is unchanged; a stale one is re-parsed.
+// Words written as +word are required: a query with any of them matches
+// only documents containing all of them.
+class PreparedQuery {
+   public:
+    PreparedQuery() = default;
+
+    const std::string &GetRawQuery() const;
+
+    std::uint64_t GetGeneration() const;
+
+   private:
+    friend class SearchServer;
+
+    struct Term {
+        std::string_view word;
+        const std::pmr::map<int, double> *document_freqs;
+        const PostingList *postings;
+        double inverse_document_freq;
+        bool is_required = false;
+    };
+
+    std::string raw_query_;
+    const SearchServer *server_ = nullptr;
+    std::uint64_t generation_ = 0;
+    std::vector<Term> plus_terms_;
+    std::vector<Term> minus_terms_;
+    bool is_conjunctive_ = false;
+    // A required word absent from the index: nothing can match
+    bool has_missing_required_term_ = false;
+    // Scored with the impacts stored in postings instead of IDF
+    bool uses_impacts_ = false;
+};
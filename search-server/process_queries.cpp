@@ -1,20 +1,43 @@
 #include "process_queries.h"
 
+#include <utility>
+
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries) {
+    const std::vector<std::string>& queries,
+    QueryLogWriter* query_log) {
     std::vector<std::vector<Document>> results(queries.size());
+    if (query_log == nullptr) {
+        std::transform(std::execution::par, queries.begin(), queries.end(),
+                       results.begin(), [&search_server](const std::string& query) {
+                           return search_server.FindTopDocuments(query);
+                       });
+        return results;
+    }
+    // An exception escaping a parallel algorithm calls std::terminate, so
+    // the log is written afterwards, where a write error reaches the caller
+    std::vector<std::pair<std::chrono::microseconds, std::vector<Document>>>
+        logged_results(queries.size());
     std::transform(std::execution::par, queries.begin(), queries.end(),
-                   results.begin(), [&search_server](const std::string query) {
-                       return search_server.FindTopDocuments(query);
+                   logged_results.begin(),
+                   [&search_server, query_log](const std::string& query) {
+                       const auto arrival = query_log->Now();
+                       return std::pair{arrival,
+                                        search_server.FindTopDocuments(query)};
                    });
+    for (std::size_t i = 0; i < queries.size(); ++i) {
+        auto& [arrival, documents] = logged_results[i];
+        query_log->Write(arrival, queries[i], DocumentStatus::ACTUAL, documents);
+        results[i] = std::move(documents);
+    }
     return results;
 }
 
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server,
-                                    const std::vector<std::string>& queries) {
+                                    const std::vector<std::string>& queries,
+                                    QueryLogWriter* query_log) {
     std::vector<Document> results;
-    for (const auto &docs : ProcessQueries(search_server, queries)) {
+    for (const auto &docs : ProcessQueries(search_server, queries, query_log)) {
         for (const auto doc : docs) {
             results.push_back(doc);
         } 
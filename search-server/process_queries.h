@@ -3,12 +3,17 @@
 #include <algorithm>
 #include <numeric>
 #include <execution>
+#include "query_log.h"
 #include "search_server.h"
 
+// Every query is also written to query_log, if given, in query order once
+// all of them have run. A failed write throws std::system_error.
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
+    const std::vector<std::string>& queries,
+    QueryLogWriter* query_log = nullptr);
 
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries,
+    QueryLogWriter* query_log = nullptr);
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "query_arena.h"
+
+#include <cstddef>
+#include <memory>
+
+namespace {
+
+// Enough for the scratch of a typical query without touching upstream
+constexpr std::size_t INITIAL_ARENA_SIZE = 64 * 1024;
+
+struct QueryArena {
+    std::unique_ptr<std::byte[]> initial_buffer =
+        std::make_unique<std::byte[]>(INITIAL_ARENA_SIZE);
+    std::pmr::monotonic_buffer_resource resource{
+        initial_buffer.get(), INITIAL_ARENA_SIZE,
+        std::pmr::new_delete_resource()};
+    int depth = 0;
+};
+
+QueryArena &GetThreadArena() {
+    thread_local QueryArena arena;
+    return arena;
+}
+
+}  // namespace
+
+QueryArenaScope::QueryArenaScope() { ++GetThreadArena().depth; }
+
+QueryArenaScope::~QueryArenaScope() {
+    QueryArena &arena = GetThreadArena();
+    if (--arena.depth == 0) {
+        arena.resource.release();
+    }
+}
+
+std::pmr::memory_resource *GetQueryArena() {
+    return &GetThreadArena().resource;
+}
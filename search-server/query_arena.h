@@ -0,0 +1,18 @@
+#pragma once
+
+#include <memory_resource>
+
+// Per-thread monotonic arena for memory that only lives while a query
+// runs. Allocate from GetQueryArena() inside a QueryArenaScope; the arena
+// is released when the outermost scope on the thread ends.
+class QueryArenaScope {
+   public:
+    QueryArenaScope();
+    ~QueryArenaScope();
+
+    QueryArenaScope(const QueryArenaScope &) = delete;
+    QueryArenaScope &operator=(const QueryArenaScope &) = delete;
+};
+
+// Not thread-safe, use only from the thread that opened the scope
+std::pmr::memory_resource *GetQueryArena();
@@ -0,0 +1,168 @@
+#include "query_log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+
+using namespace std::literals;
+
+namespace {
+
+constexpr std::string_view MAGIC = "SQLG"sv;
+constexpr std::uint32_t VERSION = 1;
+constexpr std::uint8_t CUSTOM_PREDICATE = 0xFF;
+// Buffered records are written out past this size
+constexpr std::size_t FLUSH_SIZE = 1 << 16;
+
+template <typename Integer>
+void AppendInteger(std::string &buffer, Integer value) {
+    using Unsigned = std::make_unsigned_t<Integer>;
+    const auto bits = static_cast<Unsigned>(value);
+    for (std::size_t byte = 0; byte < sizeof(Integer); ++byte) {
+        buffer.push_back(static_cast<char>((bits >> (8 * byte)) & 0xFF));
+    }
+}
+
+// Returns false if data is too short
+template <typename Integer>
+bool TakeInteger(std::string_view &data, Integer &value) {
+    using Unsigned = std::make_unsigned_t<Integer>;
+    if (data.size() < sizeof(Integer)) {
+        return false;
+    }
+    Unsigned bits = 0;
+    for (std::size_t byte = 0; byte < sizeof(Integer); ++byte) {
+        bits |= static_cast<Unsigned>(static_cast<unsigned char>(data[byte]))
+                << (8 * byte);
+    }
+    value = static_cast<Integer>(bits);
+    data.remove_prefix(sizeof(Integer));
+    return true;
+}
+
+// Returns false on a record cut short, as the last one of a log whose
+// writer was killed. Throws on a record no writer could have produced.
+bool TakeRecord(std::string_view &data, QueryLogRecord &record,
+                const std::string &path) {
+    std::uint64_t arrival_us;
+    std::uint32_t query_size;
+    std::uint8_t status;
+    std::uint32_t document_count;
+    if (!TakeInteger(data, arrival_us) || !TakeInteger(data, query_size) ||
+        data.size() < query_size) {
+        return false;
+    }
+    record.arrival = std::chrono::microseconds(arrival_us);
+    record.raw_query.assign(data.substr(0, query_size));
+    data.remove_prefix(query_size);
+    if (!TakeInteger(data, status) || !TakeInteger(data, document_count) ||
+        data.size() / sizeof(std::int32_t) < document_count) {
+        return false;
+    }
+    if (status == CUSTOM_PREDICATE) {
+        record.status.reset();
+    } else if (status <= static_cast<std::uint8_t>(DocumentStatus::REMOVED)) {
+        record.status = static_cast<DocumentStatus>(status);
+    } else {
+        throw std::invalid_argument(path + " has a record of unknown status "s +
+                                    std::to_string(status));
+    }
+    record.document_ids.resize(document_count);
+    for (int &document_id : record.document_ids) {
+        TakeInteger(data, document_id);
+    }
+    return true;
+}
+
+}  // namespace
+
+QueryLogWriter::QueryLogWriter(const std::string &path)
+    : file_(std::fopen(path.c_str(), "wb")), path_(path) {
+    if (file_ == nullptr) {
+        throw std::system_error(errno, std::generic_category(), path);
+    }
+    buffer_.append(MAGIC);
+    AppendInteger(buffer_, VERSION);
+}
+
+QueryLogWriter::~QueryLogWriter() {
+    try {
+        Flush();
+    } catch (const std::system_error &) {
+        // Nobody to report to
+    }
+    std::fclose(file_);
+}
+
+std::chrono::microseconds QueryLogWriter::Now() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_);
+}
+
+void QueryLogWriter::Write(std::chrono::microseconds arrival,
+                           std::string_view raw_query,
+                           std::optional<DocumentStatus> status,
+                           const std::vector<Document> &documents) {
+    std::lock_guard lock(mutex_);
+    AppendInteger(buffer_, static_cast<std::uint64_t>(arrival.count()));
+    AppendInteger(buffer_, static_cast<std::uint32_t>(raw_query.size()));
+    buffer_.append(raw_query);
+    AppendInteger(buffer_, status ? static_cast<std::uint8_t>(*status)
+                                  : CUSTOM_PREDICATE);
+    AppendInteger(buffer_, static_cast<std::uint32_t>(documents.size()));
+    for (const Document &document : documents) {
+        AppendInteger(buffer_, static_cast<std::int32_t>(document.id));
+    }
+    if (buffer_.size() >= FLUSH_SIZE) {
+        const std::size_t size = buffer_.size();
+        const std::size_t written = std::fwrite(buffer_.data(), 1, size, file_);
+        buffer_.clear();
+        if (written < size) {
+            throw std::system_error(errno, std::generic_category(), path_);
+        }
+    }
+}
+
+void QueryLogWriter::Flush() {
+    std::lock_guard lock(mutex_);
+    const std::size_t size = buffer_.size();
+    const std::size_t written = std::fwrite(buffer_.data(), 1, size, file_);
+    buffer_.clear();
+    if (written < size || std::fflush(file_) != 0) {
+        throw std::system_error(errno, std::generic_category(), path_);
+    }
+}
+
+std::vector<QueryLogRecord> ReadQueryLog(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::system_error(errno, std::generic_category(), path);
+    }
+    const std::string contents((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+    std::string_view data = contents;
+    std::uint32_t version = 0;
+    if (data.substr(0, MAGIC.size()) == MAGIC) {
+        data.remove_prefix(MAGIC.size());
+        TakeInteger(data, version);
+    }
+    if (version != VERSION) {
+        throw std::invalid_argument(path + " is not a query log of version "s +
+                                    std::to_string(VERSION));
+    }
+
+    std::vector<QueryLogRecord> records;
+    for (QueryLogRecord record; !data.empty() && TakeRecord(data, record, path);) {
+        records.push_back(std::move(record));
+    }
+    // Concurrent queries are written as they complete
+    std::stable_sort(records.begin(), records.end(),
+                     [](const QueryLogRecord &lhs, const QueryLogRecord &rhs) {
+                         return lhs.arrival < rhs.arrival;
+                     });
+    return records;
+}
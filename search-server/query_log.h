@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+struct QueryLogRecord {
+    // Since the log was opened
+    std::chrono::microseconds arrival{0};
+    std::string raw_query;
+    // Empty for queries filtered by a custom predicate, which a replay
+    // cannot reproduce
+    std::optional<DocumentStatus> status;
+    // Ids of the returned documents, in result order
+    std::vector<int> document_ids;
+};
+
+// Appends queries with their arrival times and results to a binary file.
+// Safe to call from several threads; records appear in completion order.
+//
+// File: "SQLG" and a 32-bit version, then records of little-endian
+//   u64 arrival_us, u32 query_size, query bytes, u8 status (0xFF: custom
+//   predicate), u32 document_count, i32 document_id * document_count
+class QueryLogWriter {
+   public:
+    explicit QueryLogWriter(const std::string &path);
+
+    QueryLogWriter(const QueryLogWriter &) = delete;
+    QueryLogWriter &operator=(const QueryLogWriter &) = delete;
+
+    ~QueryLogWriter();
+
+    // Arrival time of a query that starts now, to pass to Write
+    std::chrono::microseconds Now() const;
+
+    void Write(std::chrono::microseconds arrival, std::string_view raw_query,
+               std::optional<DocumentStatus> status,
+               const std::vector<Document> &documents);
+
+    void Flush();
+
+   private:
+    const std::chrono::steady_clock::time_point start_ =
+        std::chrono::steady_clock::now();
+    std::mutex mutex_;
+    std::FILE *file_ = nullptr;
+    std::string path_;
+    std::string buffer_;
+};
+
+// All records of a log, sorted by arrival
+std::vector<QueryLogRecord> ReadQueryLog(const std::string &path);
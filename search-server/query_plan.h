@@ -0,0 +1,21 @@
+#pragma once
+
+#include <execution>
+#include <type_traits>
+
+template <typename Policy>
+inline constexpr bool IS_PARALLEL_POLICY =
+    std::is_same_v<std::decay_t<Policy>, std::execution::parallel_policy> ||
+    std::is_same_v<std::decay_t<Policy>,
+                   std::execution::parallel_unsequenced_policy>;
+
+// Policy the scoring kernels run with: parallel ones score in parallel,
+// any other sequentially
+template <typename Policy>
+auto GetScoringPolicy(const Policy &) {
+    if constexpr (IS_PARALLEL_POLICY<Policy>) {
+        return std::execution::par;
+    } else {
+        return std::execution::seq;
+    }
+}
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "corpus_loader.h"
+#include "query_log.h"
+#include "search_server.h"
+
+// Usage: query_replay <corpus_file> <query_log> [--speed <x> | --qps <n>]
+//                     [--threads <n>] [--stop-words "<words>"]
+// Loads the corpus, then replays the log open loop: every query is due at
+// its recorded arrival time divided by the speed, or at a fixed rate with
+// --qps, whether or not earlier ones have finished. Latency counts from the
+// due time, so a lagging replay shows up as queueing. Results are checked
+// against the recorded ones, which holds when the corpus is the one the
+// log was captured on.
+namespace {
+
+struct ReplayOptions {
+    std::string corpus_path;
+    std::string log_path;
+    double speed = 1.0;
+    double qps = 0.0;
+    std::size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+    std::string stop_words;
+};
+
+struct ThreadStats {
+    std::vector<std::int64_t> latencies_us;
+    std::size_t count_mismatches = 0;
+    std::size_t order_mismatches = 0;
+    std::size_t unchecked = 0;
+    std::size_t errors = 0;
+};
+
+bool ParseOptions(int argc, char *argv[], ReplayOptions &options) {
+    if (argc < 3) {
+        return false;
+    }
+    options.corpus_path = argv[1];
+    options.log_path = argv[2];
+    for (int i = 3; i + 1 < argc; i += 2) {
+        const std::string name = argv[i];
+        const char *value = argv[i + 1];
+        if (name == "--speed"s) {
+            options.speed = std::atof(value);
+        } else if (name == "--qps"s) {
+            options.qps = std::atof(value);
+        } else if (name == "--threads"s) {
+            options.thread_count = static_cast<std::size_t>(std::atoi(value));
+        } else if (name == "--stop-words"s) {
+            options.stop_words = value;
+        } else {
+            return false;
+        }
+    }
+    return argc % 2 == 1 && options.speed > 0.0 && options.qps >= 0.0 &&
+           options.thread_count > 0;
+}
+
+// Offsets from the replay start at which the queries are due
+std::vector<std::chrono::nanoseconds> Schedule(
+    const std::vector<QueryLogRecord> &records, const ReplayOptions &options) {
+    std::vector<std::chrono::nanoseconds> due(records.size());
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        const double seconds =
+            options.qps > 0.0
+                ? i / options.qps
+                : std::chrono::duration<double>(records[i].arrival -
+                                                records.front().arrival)
+                          .count() /
+                      options.speed;
+        due[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::duration<double>(seconds));
+    }
+    return due;
+}
+
+void ReplayQuery(const SearchServer &search_server,
+                 const QueryLogRecord &record, ThreadStats &stats) {
+    std::vector<Document> documents;
+    try {
+        documents = search_server.FindTopDocuments(
+            record.raw_query, record.status.value_or(DocumentStatus::ACTUAL));
+    } catch (const std::exception &) {
+        ++stats.errors;
+        return;
+    }
+    if (!record.status) {
+        ++stats.unchecked;
+    } else if (documents.size() != record.document_ids.size()) {
+        ++stats.count_mismatches;
+    } else if (!std::equal(documents.begin(), documents.end(),
+                           record.document_ids.begin(),
+                           [](const Document &document, int document_id) {
+                               return document.id == document_id;
+                           })) {
+        ++stats.order_mismatches;
+    }
+}
+
+std::int64_t Percentile(const std::vector<std::int64_t> &sorted, double share) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const auto rank = static_cast<std::size_t>(share * (sorted.size() - 1));
+    return sorted[rank];
+}
+
+// Power-of-two buckets from 1 us
+void PrintHistogram(const std::vector<std::int64_t> &sorted) {
+    if (sorted.empty()) {
+        return;
+    }
+    constexpr int BAR_WIDTH = 50;
+    std::size_t begin = 0;
+    for (std::int64_t upper = 1; begin < sorted.size(); upper *= 2) {
+        const std::size_t end = static_cast<std::size_t>(
+            std::upper_bound(sorted.begin() + begin, sorted.end(), upper - 1) -
+            sorted.begin());
+        if (end > begin) {
+            const std::size_t count = end - begin;
+            std::cout << std::setw(10) << "< "s + std::to_string(upper) << " us "s
+                      << std::setw(9) << count << ' '
+                      << std::string(count * BAR_WIDTH / sorted.size(), '#')
+                      << '\n';
+        }
+        begin = end;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    ReplayOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        std::cerr << "Usage: "s << argv[0]
+                  << " <corpus_file> <query_log> [--speed <x> | --qps <n>]"s
+                     " [--threads <n>] [--stop-words \"<words>\"]"s
+                  << std::endl;
+        return 1;
+    }
+
+    SearchServer search_server(options.stop_words);
+    std::vector<QueryLogRecord> records;
+    try {
+        const CorpusLoadStats load_stats =
+            LoadCorpus(search_server, options.corpus_path);
+        records = ReadQueryLog(options.log_path);
+        std::cout << "documents: "s << load_stats.document_count
+                  << ", queries: "s << records.size() << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (records.empty()) {
+        return 0;
+    }
+
+    const std::vector<std::chrono::nanoseconds> due = Schedule(records, options);
+    std::atomic<std::size_t> next_query{0};
+    std::vector<ThreadStats> stats(options.thread_count);
+    std::vector<std::thread> threads;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t thread = 0; thread < options.thread_count; ++thread) {
+        threads.emplace_back([&, thread] {
+            ThreadStats &thread_stats = stats[thread];
+            for (std::size_t i; (i = next_query.fetch_add(1)) < records.size();) {
+                const auto due_time = start + due[i];
+                std::this_thread::sleep_until(due_time);
+                ReplayQuery(search_server, records[i], thread_stats);
+                thread_stats.latencies_us.push_back(
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - due_time)
+                        .count());
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    const double elapsed = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+
+    ThreadStats total;
+    for (const ThreadStats &thread_stats : stats) {
+        total.latencies_us.insert(total.latencies_us.end(),
+                                  thread_stats.latencies_us.begin(),
+                                  thread_stats.latencies_us.end());
+        total.count_mismatches += thread_stats.count_mismatches;
+        total.order_mismatches += thread_stats.order_mismatches;
+        total.unchecked += thread_stats.unchecked;
+        total.errors += thread_stats.errors;
+    }
+    std::sort(total.latencies_us.begin(), total.latencies_us.end());
+    const double scheduled =
+        std::chrono::duration<double>(due.back()).count();
+    std::cout << "seconds: "s << elapsed << " (scheduled "s << scheduled
+              << ")\n"
+              << "QPS: "s << static_cast<std::int64_t>(records.size() / elapsed)
+              << '\n'
+              << "p50: "s << Percentile(total.latencies_us, 0.50)
+              << " us, p90: "s << Percentile(total.latencies_us, 0.90)
+              << " us, p99: "s << Percentile(total.latencies_us, 0.99)
+              << " us, p99.9: "s << Percentile(total.latencies_us, 0.999)
+              << " us, max: "s << total.latencies_us.back() << " us\n";
+    PrintHistogram(total.latencies_us);
+    std::cout << "result count mismatches: "s << total.count_mismatches
+              << ", order mismatches: "s << total.order_mismatches
+              << ", unchecked: "s << total.unchecked << ", errors: "s
+              << total.errors << std::endl;
+    return total.count_mismatches + total.order_mismatches + total.errors == 0
+               ? 0
+               : 2;
+}
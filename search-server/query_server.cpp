@@ -0,0 +1,537 @@
+#include "query_server.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <execution>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include "document_record.h"
+#include "string_processing.h"
+
+namespace {
+
+constexpr std::uint64_t LISTEN_TOKEN = std::numeric_limits<std::uint64_t>::max();
+constexpr std::uint64_t WAKE_TOKEN = LISTEN_TOKEN - 1;
+constexpr std::size_t MAX_EVENTS = 64;
+constexpr std::uint32_t CONNECTION_EVENTS =
+    EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+constexpr std::size_t READ_CHUNK_SIZE = 64 * 1024;
+// A connection that sends a longer line is dropped
+constexpr std::size_t MAX_LINE_LENGTH = 1024 * 1024;
+
+[[noreturn]] void ThrowSystemError(const char *what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// I/O threads log failures instead of throwing, which would terminate the
+// process
+void LogSystemError(const char *what) {
+    const std::error_code error(errno, std::generic_category());
+    std::cerr << "query_server: "s << what << ": "s << error.message()
+              << std::endl;
+}
+
+bool IsWriteRequest(std::string_view line) {
+    const std::string_view command = TakeWord(line);
+    return command == "ADD"sv || command == "REMOVE"sv;
+}
+
+void AddToEpoll(int epoll_fd, int fd, std::uint32_t events,
+                std::uint64_t token) {
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = token;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        ThrowSystemError("epoll_ctl");
+    }
+}
+
+}  // namespace
+
+QueryServer::QueryServer(SearchServer &search_server,
+                         const QueryServerOptions &options)
+    : search_server_(search_server),
+      options_(options),
+      requests_(options.queue_capacity) {
+    if (options_.io_thread_count == 0 || options_.max_batch_size == 0 ||
+        options_.max_output_size == 0) {
+        throw std::invalid_argument(
+            "I/O thread count, batch size and output size must be positive"s);
+    }
+    in_addr bind_address{};
+    if (inet_pton(AF_INET, options_.bind_address.c_str(), &bind_address) != 1) {
+        throw std::invalid_argument("Bind address "s + options_.bind_address +
+                                    " is not an IPv4 address"s);
+    }
+    try {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            ThrowSystemError("socket");
+        }
+        const int enable = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr = bind_address;
+        address.sin_port = htons(options_.port);
+        if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&address),
+                 sizeof(address)) < 0) {
+            ThrowSystemError("bind");
+        }
+        if (listen(listen_fd_, SOMAXCONN) < 0) {
+            ThrowSystemError("listen");
+        }
+        socklen_t address_size = sizeof(address);
+        getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&address),
+                    &address_size);
+        port_ = ntohs(address.sin_port);
+
+        for (std::size_t index = 0; index < options_.io_thread_count; ++index) {
+            IoThread &io_thread = io_threads_.emplace_back();
+            io_thread.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+            if (io_thread.epoll_fd < 0) {
+                ThrowSystemError("epoll_create1");
+            }
+            io_thread.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (io_thread.wake_fd < 0) {
+                ThrowSystemError("eventfd");
+            }
+            io_thread.spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+            if (io_thread.spare_fd < 0) {
+                ThrowSystemError("open");
+            }
+            // Every I/O thread waits on the listening socket; EPOLLEXCLUSIVE
+            // wakes only one of them per incoming connection
+            AddToEpoll(io_thread.epoll_fd, listen_fd_, EPOLLIN | EPOLLEXCLUSIVE,
+                       LISTEN_TOKEN);
+            AddToEpoll(io_thread.epoll_fd, io_thread.wake_fd, EPOLLIN, WAKE_TOKEN);
+        }
+    } catch (...) {
+        CloseDescriptors();
+        throw;
+    }
+}
+
+QueryServer::~QueryServer() {
+    Stop();
+    for (IoThread &io_thread : io_threads_) {
+        if (io_thread.thread.joinable()) {
+            io_thread.thread.join();
+        }
+    }
+    CloseDescriptors();
+}
+
+void QueryServer::Run() {
+    for (std::size_t index = 0; index < io_threads_.size(); ++index) {
+        io_threads_[index].thread = std::thread([this, index] { RunIoThread(index); });
+    }
+    RunDispatcher();
+    for (IoThread &io_thread : io_threads_) {
+        io_thread.thread.join();
+    }
+}
+
+void QueryServer::Stop() {
+    stopping_ = true;
+    requests_.Close();
+    for (IoThread &io_thread : io_threads_) {
+        const std::uint64_t one = 1;
+        [[maybe_unused]] const auto written =
+            write(io_thread.wake_fd, &one, sizeof(one));
+    }
+}
+
+std::uint16_t QueryServer::GetPort() const {
+    return port_;
+}
+
+void QueryServer::CloseDescriptors() {
+    for (IoThread &io_thread : io_threads_) {
+        for (auto &[connection_id, connection] : io_thread.connections) {
+            close(connection.fd);
+        }
+        io_thread.connections.clear();
+        if (io_thread.epoll_fd >= 0) {
+            close(io_thread.epoll_fd);
+        }
+        if (io_thread.wake_fd >= 0) {
+            close(io_thread.wake_fd);
+        }
+        if (io_thread.spare_fd >= 0) {
+            close(io_thread.spare_fd);
+        }
+    }
+    io_threads_.clear();
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+}
+
+void QueryServer::RunIoThread(std::size_t index) {
+    IoThread &io_thread = io_threads_[index];
+    epoll_event events[MAX_EVENTS];
+    while (!stopping_) {
+        const int event_count =
+            epoll_wait(io_thread.epoll_fd, events, MAX_EVENTS, -1);
+        if (event_count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Nothing more can be served through a broken epoll set
+            LogSystemError("epoll_wait");
+            Stop();
+            return;
+        }
+        for (int i = 0; i < event_count; ++i) {
+            const std::uint64_t token = events[i].data.u64;
+            if (token == LISTEN_TOKEN) {
+                AcceptConnections(index);
+            } else if (token == WAKE_TOKEN) {
+                std::uint64_t counter;
+                [[maybe_unused]] const auto read_size =
+                    read(io_thread.wake_fd, &counter, sizeof(counter));
+                DeliverCompleted(index);
+            } else {
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    ReadConnection(index, token);
+                }
+                if (events[i].events & EPOLLOUT) {
+                    FlushConnection(io_thread, token);
+                }
+            }
+        }
+    }
+}
+
+void QueryServer::AcceptConnections(std::size_t index) {
+    IoThread &io_thread = io_threads_[index];
+    while (true) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr,
+                               SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO ||
+                errno == EPERM) {
+                // The pending connection only
+                continue;
+            }
+            const int error = errno;
+            LogSystemError("accept4");
+            if (error != EMFILE && error != ENFILE) {
+                return;
+            }
+            // The listening socket is level-triggered, so a connection left
+            // in the backlog would wake the thread again at once. The spare
+            // descriptor makes room to accept the connection and drop it.
+            if (io_thread.spare_fd < 0) {
+                io_thread.spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                return;
+            }
+            close(io_thread.spare_fd);
+            const int dropped_fd =
+                accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (dropped_fd >= 0) {
+                close(dropped_fd);
+            }
+            io_thread.spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+            if (dropped_fd < 0) {
+                return;
+            }
+            continue;
+        }
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        const std::uint64_t connection_id = next_connection_id_++;
+        epoll_event event{};
+        event.events = CONNECTION_EVENTS;
+        event.data.u64 = connection_id;
+        if (epoll_ctl(io_thread.epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            LogSystemError("epoll_ctl");
+            close(fd);
+            continue;
+        }
+        io_thread.connections[connection_id].fd = fd;
+    }
+}
+
+void QueryServer::ReadConnection(std::size_t index,
+                                 std::uint64_t connection_id) {
+    IoThread &io_thread = io_threads_[index];
+    const auto it = io_thread.connections.find(connection_id);
+    if (it == io_thread.connections.end()) {
+        return;
+    }
+    Connection &connection = it->second;
+
+    // Edge-triggered: read until the socket is drained. Lines are queued
+    // after every chunk, so an overlong one is caught before it is
+    // buffered in full.
+    char buffer[READ_CHUNK_SIZE];
+    while (true) {
+        if (connection.output.size() + connection.pending_size >=
+            options_.max_output_size) {
+            // FlushConnection resumes once the client has taken enough
+            connection.is_read_paused = true;
+            break;
+        }
+        const ssize_t size = read(connection.fd, buffer, sizeof(buffer));
+        if (size > 0) {
+            connection.input.append(buffer, static_cast<std::size_t>(size));
+            if (!QueueRequests(index, connection_id)) {
+                return;
+            }
+            if (connection.input.size() > MAX_LINE_LENGTH) {
+                CloseConnection(io_thread, connection_id);
+                return;
+            }
+            continue;
+        }
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (size < 0) {
+            CloseConnection(io_thread, connection_id);
+            return;
+        }
+        // The peer has finished sending; answer what it asked and close
+        connection.closing = true;
+        break;
+    }
+    FlushConnection(io_thread, connection_id);
+}
+
+bool QueryServer::QueueRequests(std::size_t index,
+                                std::uint64_t connection_id) {
+    IoThread &io_thread = io_threads_[index];
+    Connection &connection = io_thread.connections.at(connection_id);
+    std::size_t line_begin = 0;
+    std::size_t line_end;
+    while ((line_end = connection.input.find('\n', line_begin)) != std::string::npos) {
+        std::string_view line(connection.input.data() + line_begin,
+                              line_end - line_begin);
+        line_begin = line_end + 1;
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+        Request request{index, connection_id, connection.next_sequence++,
+                        std::string(line), {}};
+        if (!requests_.TryPush(request)) {
+            // Flushes, which closes the connection if sending fails
+            QueueResponse(io_thread, connection_id, request.sequence,
+                          "ERR busy"s);
+            if (io_thread.connections.count(connection_id) == 0) {
+                return false;
+            }
+        }
+    }
+    connection.input.erase(0, line_begin);
+    return true;
+}
+
+void QueryServer::DeliverCompleted(std::size_t index) {
+    IoThread &io_thread = io_threads_[index];
+    std::vector<Request> completed;
+    {
+        std::lock_guard lock(io_thread.completed_mutex);
+        completed.swap(io_thread.completed);
+    }
+    for (Request &request : completed) {
+        QueueResponse(io_thread, request.connection_id, request.sequence,
+                      std::move(request.response));
+    }
+}
+
+void QueryServer::QueueResponse(IoThread &io_thread,
+                                std::uint64_t connection_id,
+                                std::uint64_t sequence, std::string response) {
+    const auto it = io_thread.connections.find(connection_id);
+    if (it == io_thread.connections.end()) {
+        return;
+    }
+    Connection &connection = it->second;
+    if (sequence != connection.next_to_send) {
+        connection.pending_size += response.size() + 1;
+        connection.pending_responses.emplace(sequence, std::move(response));
+        return;
+    }
+    connection.output += response;
+    connection.output += '\n';
+    ++connection.next_to_send;
+    auto pending = connection.pending_responses.begin();
+    while (pending != connection.pending_responses.end() &&
+           pending->first == connection.next_to_send) {
+        connection.output += pending->second;
+        connection.output += '\n';
+        connection.pending_size -= pending->second.size() + 1;
+        ++connection.next_to_send;
+        pending = connection.pending_responses.erase(pending);
+    }
+    FlushConnection(io_thread, connection_id);
+}
+
+void QueryServer::FlushConnection(IoThread &io_thread,
+                                  std::uint64_t connection_id) {
+    const auto it = io_thread.connections.find(connection_id);
+    if (it == io_thread.connections.end()) {
+        return;
+    }
+    Connection &connection = it->second;
+    std::size_t sent = 0;
+    while (sent < connection.output.size()) {
+        const ssize_t size =
+            send(connection.fd, connection.output.data() + sent,
+                 connection.output.size() - sent, MSG_NOSIGNAL);
+        if (size > 0) {
+            sent += static_cast<std::size_t>(size);
+            continue;
+        }
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // The rest goes out on the next EPOLLOUT edge
+            break;
+        }
+        CloseConnection(io_thread, connection_id);
+        return;
+    }
+    connection.output.erase(0, sent);
+    if (connection.closing && connection.output.empty() &&
+        connection.next_to_send == connection.next_sequence) {
+        CloseConnection(io_thread, connection_id);
+        return;
+    }
+    if (connection.is_read_paused &&
+        connection.output.size() + connection.pending_size <
+            options_.max_output_size) {
+        // Input that arrived while paused raised no new edge; re-arming
+        // reports it again
+        connection.is_read_paused = false;
+        epoll_event event{};
+        event.events = CONNECTION_EVENTS;
+        event.data.u64 = connection_id;
+        if (epoll_ctl(io_thread.epoll_fd, EPOLL_CTL_MOD, connection.fd,
+                      &event) < 0) {
+            LogSystemError("epoll_ctl");
+            CloseConnection(io_thread, connection_id);
+        }
+    }
+}
+
+void QueryServer::CloseConnection(IoThread &io_thread,
+                                  std::uint64_t connection_id) {
+    const auto it = io_thread.connections.find(connection_id);
+    if (it == io_thread.connections.end()) {
+        return;
+    }
+    // Closing the descriptor also removes it from the epoll set
+    close(it->second.fd);
+    io_thread.connections.erase(it);
+}
+
+void QueryServer::RunDispatcher() {
+    while (true) {
+        std::vector<Request> batch =
+            requests_.PopBatch(options_.max_batch_size, options_.batch_window);
+        if (batch.empty()) {
+            return;
+        }
+        ExecuteBatch(batch);
+
+        std::vector<bool> woken(io_threads_.size(), false);
+        for (Request &request : batch) {
+            woken[request.io_thread] = true;
+            IoThread &io_thread = io_threads_[request.io_thread];
+            std::lock_guard lock(io_thread.completed_mutex);
+            io_thread.completed.push_back(std::move(request));
+        }
+        for (std::size_t index = 0; index < io_threads_.size(); ++index) {
+            if (woken[index]) {
+                const std::uint64_t one = 1;
+                [[maybe_unused]] const auto written =
+                    write(io_threads_[index].wake_fd, &one, sizeof(one));
+            }
+        }
+    }
+}
+
+void QueryServer::ExecuteBatch(std::vector<Request> &batch) {
+    // Writes keep their place in the batch: every read sees exactly the
+    // writes queued before it, and runs of reads between them go parallel
+    auto run_begin = batch.begin();
+    while (run_begin != batch.end()) {
+        if (IsWriteRequest(run_begin->line)) {
+            run_begin->response = ExecuteRequest(run_begin->line);
+            ++run_begin;
+            continue;
+        }
+        const auto run_end =
+            std::find_if(run_begin, batch.end(), [](const Request &request) {
+                return IsWriteRequest(request.line);
+            });
+        std::for_each(std::execution::par, run_begin, run_end,
+                      [this](Request &request) {
+                          request.response = ExecuteRequest(request.line);
+                      });
+        run_begin = run_end;
+    }
+}
+
+std::string QueryServer::ExecuteRequest(std::string_view line) {
+    try {
+        const std::string_view command = TakeWord(line);
+        std::ostringstream response;
+        response << "OK"s;
+        if (command == "SEARCH"sv) {
+            const auto documents = search_server_.FindTopDocuments(TrimLeft(line));
+            response << ' ' << documents.size();
+            for (const Document &document : documents) {
+                response << ' ' << document.id << ':' << document.relevance
+                         << ':' << document.rating;
+            }
+        } else if (command == "MATCH"sv) {
+            const int document_id = ParseInt(TakeWord(line));
+            const auto [words, status] =
+                search_server_.MatchDocument(TrimLeft(line), document_id);
+            response << ' ' << static_cast<int>(status);
+            for (const std::string_view word : words) {
+                response << ' ' << word;
+            }
+        } else if (command == "ADD"sv) {
+            const DocumentRecord record = ParseDocumentRecord(line);
+            search_server_.AddDocument(record.id, record.text, record.status,
+                                       record.ratings);
+        } else if (command == "REMOVE"sv) {
+            search_server_.RemoveDocument(ParseInt(TakeWord(line)));
+        } else {
+            return "ERR Unknown command "s + std::string(command);
+        }
+        return response.str();
+    } catch (const std::exception &e) {
+        return "ERR "s + e.what();
+    }
+}
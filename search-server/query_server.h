@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "search_server.h"
+
+struct QueryServerOptions {
+    // IPv4 address to listen on. The protocol has no authentication and
+    // accepts writes, so only loopback is served unless told otherwise.
+    std::string bind_address = "127.0.0.1";
+    // 0 binds an ephemeral port, see QueryServer::GetPort
+    std::uint16_t port = 0;
+    std::size_t io_thread_count = 2;
+    // Requests that arrive within batch_window of the first one are
+    // executed together, at most max_batch_size at a time
+    std::size_t max_batch_size = 64;
+    std::chrono::microseconds batch_window{200};
+    // Requests beyond this many waiting ones are answered with ERR busy
+    std::size_t queue_capacity = 4096;
+    // A connection is not read from while this many bytes of its responses
+    // wait to be sent, so a client that does not read cannot make the
+    // server buffer without bound. Requests already queued may still add
+    // their responses.
+    std::size_t max_output_size = 4 * 1024 * 1024;
+};
+
+// TCP front for a SearchServer. Non-blocking epoll I/O threads parse
+// newline-terminated requests and queue them; one dispatcher thread drains
+// the queue in batches, runs consecutive reads in parallel and writes one
+// by one, so the SearchServer itself needs no locking. Responses go back
+// in request order on every connection.
+//
+//   SEARCH <query>                             OK <count> <id>:<relevance>:<rating>...
+//   MATCH <document_id> <query>                OK <status> <word>...
+//   ADD <document_id> <status> <r1,r2,...|-> <text>
+//                                              OK
+//   REMOVE <document_id>                       OK
+//
+// Statuses are numbers of DocumentStatus. Failures answer ERR <message>.
+class QueryServer {
+   public:
+    QueryServer(SearchServer &search_server,
+                const QueryServerOptions &options = {});
+
+    QueryServer(const QueryServer &) = delete;
+    QueryServer &operator=(const QueryServer &) = delete;
+
+    ~QueryServer();
+
+    // Serves until Stop is called from another thread
+    void Run();
+
+    void Stop();
+
+    std::uint16_t GetPort() const;
+
+   private:
+    struct Request {
+        std::size_t io_thread;
+        std::uint64_t connection_id;
+        std::uint64_t sequence;
+        std::string line;
+        std::string response;
+    };
+
+    struct Connection {
+        int fd = -1;
+        std::string input;
+        std::string output;
+        std::uint64_t next_sequence = 0;
+        std::uint64_t next_to_send = 0;
+        // Responses that overtook an earlier request of the connection
+        std::map<std::uint64_t, std::string> pending_responses;
+        std::size_t pending_size = 0;
+        bool closing = false;
+        // Set while output and pending responses reach max_output_size
+        bool is_read_paused = false;
+    };
+
+    struct IoThread {
+        int epoll_fd = -1;
+        int wake_fd = -1;
+        // Held open to be given up when descriptors run out, so that a
+        // pending connection can be accepted and dropped
+        int spare_fd = -1;
+        std::thread thread;
+        std::unordered_map<std::uint64_t, Connection> connections;
+        std::mutex completed_mutex;
+        std::vector<Request> completed;
+    };
+
+    SearchServer &search_server_;
+    const QueryServerOptions options_;
+    int listen_fd_ = -1;
+    std::uint16_t port_ = 0;
+    std::atomic<bool> stopping_{false};
+    std::atomic<std::uint64_t> next_connection_id_{0};
+    BoundedQueue<Request> requests_;
+    std::deque<IoThread> io_threads_;
+
+    void CloseDescriptors();
+
+    void RunIoThread(std::size_t index);
+    void AcceptConnections(std::size_t index);
+    void ReadConnection(std::size_t index, std::uint64_t connection_id);
+    // Queues the complete lines of the connection's input; false once the
+    // connection is closed
+    bool QueueRequests(std::size_t index, std::uint64_t connection_id);
+    void DeliverCompleted(std::size_t index);
+    void QueueResponse(IoThread &io_thread, std::uint64_t connection_id,
+                       std::uint64_t sequence, std::string response);
+    void FlushConnection(IoThread &io_thread, std::uint64_t connection_id);
+    void CloseConnection(IoThread &io_thread, std::uint64_t connection_id);
+
+    void RunDispatcher();
+    void ExecuteBatch(std::vector<Request> &batch);
+    std::string ExecuteRequest(std::string_view line);
+};
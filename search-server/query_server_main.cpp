@@ -0,0 +1,49 @@
+#include <pthread.h>
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "query_server.h"
+#include "search_server.h"
+
+// Usage: query_server [port] [io_threads] ["stop words"] [bind_address]
+// Serves an initially empty index until SIGINT or SIGTERM; documents are
+// added over the wire with ADD. Listens on 127.0.0.1 unless bind_address,
+// for example 0.0.0.0, says otherwise: anyone who can connect may write.
+int main(int argc, char *argv[]) {
+    QueryServerOptions options;
+    options.port = 8080;
+    if (argc > 1) {
+        options.port = static_cast<std::uint16_t>(std::atoi(argv[1]));
+    }
+    if (argc > 2) {
+        options.io_thread_count = static_cast<std::size_t>(std::atoi(argv[2]));
+    }
+    const std::string stop_words = argc > 3 ? argv[3] : ""s;
+    if (argc > 4) {
+        options.bind_address = argv[4];
+    }
+
+    // Signals are taken by a dedicated thread; the server threads inherit
+    // the blocked mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    SearchServer search_server(stop_words);
+    QueryServer query_server(search_server, options);
+    std::thread signal_waiter([&signals, &query_server] {
+        int signal_number;
+        sigwait(&signals, &signal_number);
+        query_server.Stop();
+    });
+    std::cerr << "Listening on port "s << query_server.GetPort() << std::endl;
+    query_server.Run();
+    signal_waiter.join();
+    return 0;
+}
@@ -7,7 +7,7 @@ void RemoveDuplicates(SearchServer& search_server) {
 		set<string> uniq_words;
 		auto words_freq = search_server.GetWordFrequencies(document_id);
 		for (auto [word, freq] : words_freq) {
-			uniq_words.insert(word);
+			uniq_words.insert(std::string{word});
 		}
 		if (set_of_words.count(uniq_words)) {
 			duplicates.insert(document_id);
@@ -1,5 +1,34 @@
-#include "document.h"
+#include "request_queue.h"
 
+std::vector<Document> RequestQueue::AddFindRequest(const std::string &raw_query, DocumentStatus status)
+{
+    const std::chrono::microseconds arrival = query_log_ ? query_log_->Now() : std::chrono::microseconds{0};
+    std::vector<Document> result = search_server_.FindTopDocuments(raw_query, status);
+    AddResult(arrival, raw_query, status, result);
+    return result;
+}
 
-std::string ReadLine();
-int ReadLineWithNumber();
+std::vector<Document> RequestQueue::AddFindRequest(const std::string &raw_query)
+{
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
+}
+
+int RequestQueue::GetNoResultRequests() const
+{
+    return static_cast<int>(std::count_if(requests_.begin(), requests_.end(),
+                                          [](const QueryResult &request) { return request.is_empty; }));
+}
+
+void RequestQueue::AddResult(std::chrono::microseconds arrival, const std::string &raw_query,
+                             std::optional<DocumentStatus> status, const std::vector<Document> &result)
+{
+    if (query_log_)
+    {
+        query_log_->Write(arrival, raw_query, status, result);
+    }
+    requests_.push_back({result.empty(), result});
+    if (requests_.size() > min_in_day_)
+    {
+        requests_.pop_front();
+    }
+}
@@ -1,12 +1,16 @@
 #pragma once
 
+#include "query_log.h"
 #include "search_server.h"
 #include <deque>
+#include <optional>
 
 class RequestQueue
 {
 public:
-    explicit RequestQueue(SearchServer &search_server) : search_server_(search_server) {}
+    // Every request is also written to query_log, if given
+    explicit RequestQueue(SearchServer &search_server, QueryLogWriter *query_log = nullptr)
+        : search_server_(search_server), query_log_(query_log) {}
     // сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики
     // template <typename DocumentPredicate>
     template <typename DocumentPredicate>
@@ -28,18 +32,17 @@ private:
     std::deque<QueryResult> requests_;
     const static int min_in_day_ = 1440;
     const SearchServer &search_server_;
+    QueryLogWriter *query_log_;
+
+    void AddResult(std::chrono::microseconds arrival, const std::string &raw_query,
+                   std::optional<DocumentStatus> status, const std::vector<Document> &result);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string &raw_query, DocumentPredicate document_predicate)
 {
-    // напишите реализацию
+    const std::chrono::microseconds arrival = query_log_ ? query_log_->Now() : std::chrono::microseconds{0};
     std::vector<Document> result = search_server_.FindTopDocuments(raw_query, document_predicate);
-
-    requests_.push_back({result.empty(), result});
-    if (requests_.size() > min_in_day_)
-    {
-        requests_.pop_front();
-    }
+    AddResult(arrival, raw_query, std::nullopt, result);
     return result;
 }
\ No newline at end of file
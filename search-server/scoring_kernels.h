@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// SSE2 is left out: every x86-64 CPU has it, and multiplying two products
+// at a time before a scalar scatter was no faster than the scalar kernel
+enum class ScoringIsa {
+    SCALAR,
+    // Gathers four relevances, stores them back one by one
+    AVX2,
+    // Gathers and scatters eight relevances
+    AVX512,
+};
+
+// relevance[document_indices[i]] += term_freqs[i] * inverse_document_freq
+// for i < count. Indices within one call must be distinct.
+using AccumulateKernel = void (*)(const std::uint32_t *document_indices,
+                                  const double *term_freqs, std::size_t count,
+                                  double inverse_document_freq,
+                                  double *relevance);
+
+bool IsScoringIsaSupported(ScoringIsa isa);
+
+// Widest instruction set available on this CPU
+ScoringIsa DetectScoringIsa();
+
+// Falls back to the scalar kernel when isa is not supported
+AccumulateKernel GetAccumulateKernel(ScoringIsa isa);
+
+// Impacts are tf-idf products in fixed point. With 24 fractional bits the
+// rounding error of a query's sum stays far below EPS, and 8 integer bits
+// cover the IDF of any 32-bit document count. Sums are 32-bit too, so a
+// query whose impacts could overflow one is scored exactly instead.
+constexpr int IMPACT_FRACTION_BITS = 24;
+constexpr double IMPACT_UNIT = 1.0 / (1 << IMPACT_FRACTION_BITS);
+
+// Rounded to the nearest unit, clamped to the uint32_t range
+std::uint32_t QuantizeImpact(double impact);
+
+// sums[document_indices[i]] += impacts[i] for i < count
+void AccumulateImpacts(const std::uint32_t *document_indices,
+                       const std::uint32_t *impacts, std::size_t count,
+                       std::uint32_t *sums);
@@ -0,0 +1,38 @@
+#include "search_budget.h"
+
+#include <utility>
+
+CancellationToken::CancellationToken()
+    : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+void CancellationToken::Cancel() {
+    cancelled_->store(true, std::memory_order_relaxed);
+}
+
+bool CancellationToken::IsCancelled() const {
+    return cancelled_->load(std::memory_order_relaxed);
+}
+
+SearchBudget::SearchBudget(std::chrono::steady_clock::time_point deadline,
+                           CancellationToken token)
+    : deadline_(deadline), token_(std::move(token)) {}
+
+SearchBudget::SearchBudget(std::chrono::steady_clock::duration time_budget,
+                           CancellationToken token)
+    : SearchBudget(std::chrono::steady_clock::now() + time_budget,
+                   std::move(token)) {}
+
+bool SearchBudget::CheckExpired() {
+    if (expired_.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    if (token_.IsCancelled() || std::chrono::steady_clock::now() >= deadline_) {
+        expired_.store(true, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+bool SearchBudget::IsExpired() const {
+    return expired_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "document.h"
+
+// Shared flag: copies handed to running searches observe Cancel
+class CancellationToken {
+   public:
+    CancellationToken();
+
+    void Cancel();
+
+    bool IsCancelled() const;
+
+   private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+// Deadline and cancellation that scoring checks once per posting block.
+// Once either fires the budget stays expired.
+class SearchBudget {
+   public:
+    explicit SearchBudget(std::chrono::steady_clock::time_point deadline,
+                          CancellationToken token = {});
+
+    explicit SearchBudget(std::chrono::steady_clock::duration time_budget,
+                          CancellationToken token = {});
+
+    // Safe to call from several scoring threads
+    bool CheckExpired();
+
+    // Whether a check has found the budget expired
+    bool IsExpired() const;
+
+   private:
+    std::chrono::steady_clock::time_point deadline_;
+    CancellationToken token_;
+    std::atomic<bool> expired_{false};
+};
+
+struct SearchResult {
+    std::vector<Document> documents;
+    // Scoring stopped early: documents are the best among those scored so
+    // far and their relevance may miss some of the query words
+    bool is_partial = false;
+};
@@ -1,40 +1,212 @@
 #include "search_server.h"
 
-SearchServer::SearchServer(const std::string& stop_words_text)
+#include <atomic>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+SearchServer::SearchServer(const std::string& stop_words_text,
+                           std::pmr::memory_resource* resource)
     : SearchServer(
-          std::string_view(stop_words_text)) 
+          std::string_view(stop_words_text), resource) 
                                             
 {}
 
-SearchServer::SearchServer(const std::string_view stop_words_text) : SearchServer(
-          SplitIntoWordsView(stop_words_text))
+SearchServer::SearchServer(const std::string_view stop_words_text,
+                           std::pmr::memory_resource* resource) : SearchServer(
+          SplitIntoWordsView(stop_words_text), resource)
 {}
 
+SearchServer::SearchServer(std::shared_ptr<const StopWordSet> stop_words,
+                           std::shared_ptr<TermDictionary> term_dictionary,
+                           std::pmr::memory_resource* resource)
+    : stop_words_(std::move(stop_words)),
+      term_dictionary_(std::move(term_dictionary)),
+      word_to_document_freqs_(resource),
+      word_to_postings_(resource),
+      documents_words_freqs_(resource),
+      document_indices_(resource),
+      document_columns_(resource),
+      document_ids_(resource),
+      renumbered_postings_(resource),
+      retired_postings_(resource)
+{
+    if (!stop_words_ || !term_dictionary_) {
+        throw std::invalid_argument("Stop words and term dictionary are required"s);
+    }
+    if (!all_of(stop_words_->begin(), stop_words_->end(), IsValidWord)) {
+        throw std::invalid_argument("Some of stop words are invalid"s);
+    }
+}
+
+std::uint64_t SearchServer::IndexGeneration::Next() {
+    static std::atomic<std::uint64_t> last_generation{0};
+    return last_generation.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+SearchServer::SearchServer(const SearchServer& other)
+    : stop_words_(other.stop_words_),
+      term_dictionary_(other.term_dictionary_),
+      word_to_document_freqs_(other.word_to_document_freqs_),
+      word_to_postings_(other.word_to_postings_),
+      documents_words_freqs_(other.documents_words_freqs_),
+      document_indices_(other.document_indices_),
+      document_columns_(other.document_columns_),
+      document_ids_(other.document_ids_),
+      generation_(other.generation_),
+      compact_cursor_(other.compact_cursor_),
+      is_renumbering_(other.is_renumbering_),
+      renumbering_(other.renumbering_),
+      renumbered_document_count_(other.renumbered_document_count_),
+      renumbered_postings_(other.renumbered_postings_),
+      retired_postings_(other.retired_postings_),
+      term_trie_cache_(other.term_trie_cache_),
+      scoring_isa_(other.scoring_isa_),
+      accumulate_kernel_(other.accumulate_kernel_),
+      impact_drift_threshold_(other.impact_drift_threshold_),
+      impact_document_count_(other.impact_document_count_),
+      is_impact_refresh_running_(other.is_impact_refresh_running_),
+      impact_refresh_cursor_(other.impact_refresh_cursor_)
+{
+    // The keys are already interned, so the views stay the same
+    for (const auto& [word, _] : word_to_document_freqs_) {
+        term_dictionary_->Acquire(word);
+    }
+}
+
+SearchServer::~SearchServer() {
+    for (const auto& [word, _] : word_to_document_freqs_) {
+        term_dictionary_->Release(word);
+    }
+}
+
 void SearchServer::AddDocument(int document_id, const std::string_view document,
                                DocumentStatus status,
                                const std::vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    if ((document_id < 0) || (document_indices_.count(document_id) > 0)) {
         throw std::invalid_argument("Invalid document_id"s);
     }
-    const auto words = SplitIntoWordsNoStop(document);
+    AddDocument(document_id, TokenizeDocument(document), status, ratings);
+}
+
+SearchServer::DocumentTerms SearchServer::TokenizeDocument(
+    const std::string_view document) const {
+    std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
+    std::sort(words.begin(), words.end());
 
+    DocumentTerms document_terms;
     const double inv_word_count = 1.0 / words.size();
-    for (const std::string& word : words) {
-        auto insertion_result = documents_words_.insert(word);
-        std::string_view inserted_word = *(insertion_result.first);
-        word_to_document_freqs_[inserted_word][document_id] += inv_word_count;
-        documents_words_freqs_[document_id][inserted_word] += inv_word_count;
-    }
-    documents_.emplace(document_id,
-                       DocumentData{ComputeAverageRating(ratings), status});
+    for (auto word = words.begin(); word != words.end();) {
+        const auto word_end = std::find_if(
+            word, words.end(), [word](const std::string_view other) {
+                return other != *word;
+            });
+        document_terms.emplace_back(*word, (word_end - word) * inv_word_count);
+        word = word_end;
+    }
+    return document_terms;
+}
+
+void SearchServer::AddDocument(int document_id,
+                               const DocumentTerms& document_terms,
+                               DocumentStatus status,
+                               const std::vector<int>& ratings) {
+    if ((document_id < 0) || (document_indices_.count(document_id) > 0)) {
+        throw std::invalid_argument("Invalid document_id"s);
+    }
+    auto& word_freqs = documents_words_freqs_[document_id];
+    for (const auto& [word, term_freq] : document_terms) {
+        auto word_it = word_to_document_freqs_.find(word);
+        if (word_it == word_to_document_freqs_.end()) {
+            word_it = word_to_document_freqs_
+                          .try_emplace(term_dictionary_->Acquire(word))
+                          .first;
+            term_trie_cache_.AddWord(word);
+        }
+        const std::string_view inserted_word = word_it->first;
+        word_it->second[document_id] = term_freq;
+        word_freqs[inserted_word] = term_freq;
+    }
+    const std::uint32_t document_index = document_columns_.Add(
+        document_id, status, ComputeAverageRating(ratings));
+    if (is_renumbering_) {
+        renumbering_.push_back(renumbered_document_count_++);
+    }
+    // Counting the document being added
+    const double document_count = document_indices_.size() + 1.0;
+    for (const auto [word, term_freq] : documents_words_freqs_[document_id]) {
+        const auto add_posting = [&](PostingList& postings,
+                                     std::uint32_t index) {
+            if (!impact_drift_threshold_) {
+                postings.Add(index, term_freq);
+                return;
+            }
+            const double inverse_document_freq = std::log(
+                document_count / word_to_document_freqs_.at(word).size());
+            if (!postings.HasImpacts()) {
+                postings.SetImpacts(inverse_document_freq);
+            }
+            postings.Add(index, term_freq,
+                         QuantizeImpact(term_freq * inverse_document_freq));
+        };
+        add_posting(word_to_postings_[word], document_index);
+        if (IsRenumbered(word)) {
+            add_posting(renumbered_postings_[word],
+                        renumbering_[document_index]);
+        }
+    }
+    document_indices_.emplace(document_id, document_index);
     document_ids_.insert(document_id);
+    generation_.Advance();
+    MaintainImpacts();
+}
+
+PreparedQuery SearchServer::Prepare(const std::string_view raw_query) const {
+    PreparedQuery query;
+    query.raw_query_ = std::string{raw_query};
+    ResolveQuery(raw_query, query);
+    return query;
+}
+
+PreparedQuery SearchServer::Prepare(const std::string_view raw_query,
+                                    const CorpusStats& corpus_stats) const {
+    PreparedQuery query;
+    query.raw_query_ = std::string{raw_query};
+    ResolveQuery(raw_query, query, &corpus_stats);
+    return query;
+}
+
+CorpusStats SearchServer::GetCorpusStats(const std::string_view raw_query) const {
+    CorpusStats::WordExpansions word_expansions;
+    for (const std::string_view word : SplitIntoWordsView(raw_query)) {
+        const QueryWord query_word = ParseQueryWord(word);
+        if (query_word.is_prefix || query_word.max_edits > 0) {
+            word_expansions.emplace(GetExpansionKey(query_word),
+                                    ExpandQueryWord(query_word));
+        }
+    }
+    return GetCorpusStats(raw_query, word_expansions);
+}
+
+CorpusStats SearchServer::GetCorpusStats(
+    const std::string_view raw_query,
+    const CorpusStats::WordExpansions& word_expansions) const {
+    QueryArenaScope arena_scope;
+    const auto parsed_query = ParseQuery(raw_query, &word_expansions);
+    CorpusStats corpus_stats;
+    corpus_stats.document_count = GetDocumentCount();
+    corpus_stats.word_expansions = word_expansions;
+    for (const std::string_view word : parsed_query.plus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        corpus_stats.document_freqs.emplace(
+            word, it == word_to_document_freqs_.end() ? 0 : it->second.size());
+    }
+    return corpus_stats;
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(
     const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(
-        raw_query, [status](int document_id, DocumentStatus document_status,
-                            int rating) { return document_status == status; });
+    return FindTopDocuments(raw_query, DocumentFilter(status));
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(
@@ -42,11 +214,154 @@ std::vector<Document> SearchServer::FindTopDocuments(
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
-int SearchServer::GetDocumentCount() const { return documents_.size(); }
+std::vector<Document> SearchServer::FindTopDocuments(
+    const std::string_view raw_query, const DocumentFilter& filter) const {
+    return FindTopDocuments(std::execution::seq, raw_query, filter);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(
+    const PreparedQuery& query, DocumentStatus status) const {
+    return FindTopDocuments(query, DocumentFilter(status));
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(
+    const PreparedQuery& query) const {
+    return FindTopDocuments(query, DocumentStatus::ACTUAL);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(
+    const PreparedQuery& query, const DocumentFilter& filter) const {
+    return FindTopDocuments(std::execution::seq, query, filter);
+}
+
+std::future<SearchResult> SearchServer::FindTopDocumentsAsync(
+    const std::string_view raw_query, DocumentStatus status,
+    std::chrono::steady_clock::duration time_budget,
+    CancellationToken token) const {
+    return FindTopDocumentsAsync(raw_query, DocumentFilter(status), time_budget,
+                                 std::move(token));
+}
+
+std::future<SearchResult> SearchServer::FindTopDocumentsAsync(
+    const std::string_view raw_query, const DocumentFilter& filter,
+    std::chrono::steady_clock::duration time_budget,
+    CancellationToken token) const {
+    const auto deadline = std::chrono::steady_clock::now() + time_budget;
+    return std::async(
+        std::launch::async,
+        [this, raw_query = std::string(raw_query), filter, deadline,
+         token = std::move(token)] {
+            SearchBudget budget(deadline, token);
+            return FindTopDocuments(std::execution::seq, Prepare(raw_query),
+                                    filter, budget);
+        });
+}
+
+std::future<SearchResult> SearchServer::FindTopDocumentsAsync(
+    const std::string_view raw_query,
+    std::chrono::steady_clock::duration time_budget,
+    CancellationToken token) const {
+    return FindTopDocumentsAsync(raw_query, DocumentStatus::ACTUAL, time_budget,
+                                 std::move(token));
+}
+
+int SearchServer::GetDocumentCount() const { return document_indices_.size(); }
+
+std::uint64_t SearchServer::GetGeneration() const { return generation_.Get(); }
+
+void SearchServer::SetScoringIsa(ScoringIsa isa) {
+    if (!IsScoringIsaSupported(isa)) {
+        throw std::invalid_argument("Scoring ISA is not supported by this CPU"s);
+    }
+    scoring_isa_ = isa;
+    accumulate_kernel_ = GetAccumulateKernel(isa);
+}
+
+ScoringIsa SearchServer::GetScoringIsa() const { return scoring_isa_; }
 
-std::set<int>::iterator SearchServer::begin() { return document_ids_.begin(); }
+void SearchServer::EnableImpactScoring(double drift_threshold) {
+    if (!(drift_threshold >= 0.0)) {
+        throw std::invalid_argument("Impact drift threshold is negative"s);
+    }
+    impact_drift_threshold_ = drift_threshold;
+    is_impact_refresh_running_ = false;
+    RefreshImpacts();
+    generation_.Advance();
+}
 
-std::set<int>::iterator SearchServer::end() { return document_ids_.end(); }
+void SearchServer::DisableImpactScoring() {
+    if (!impact_drift_threshold_) {
+        return;
+    }
+    impact_drift_threshold_.reset();
+    is_impact_refresh_running_ = false;
+    impact_refresh_cursor_.clear();
+    for (auto* word_postings : {&word_to_postings_, &renumbered_postings_}) {
+        for (auto& [_, postings] : *word_postings) {
+            postings.ClearImpacts();
+        }
+    }
+    generation_.Advance();
+}
+
+bool SearchServer::IsImpactScoringEnabled() const {
+    return impact_drift_threshold_.has_value();
+}
+
+bool SearchServer::RefreshImpacts(std::size_t max_words) {
+    if (!impact_drift_threshold_) {
+        return true;
+    }
+    if (!is_impact_refresh_running_) {
+        is_impact_refresh_running_ = true;
+        impact_refresh_cursor_.clear();
+        impact_document_count_ = GetDocumentCount();
+    }
+    const double document_count = GetDocumentCount();
+    auto it = word_to_postings_.lower_bound(impact_refresh_cursor_);
+    for (std::size_t refreshed = 0;
+         it != word_to_postings_.end() && refreshed < max_words;
+         ++it, ++refreshed) {
+        PostingList& postings = it->second;
+        const double inverse_document_freq =
+            postings.IsEmpty() ? 0.0
+                               : std::log(document_count / postings.GetSize());
+        postings.SetImpacts(inverse_document_freq);
+        if (IsRenumbered(it->first)) {
+            renumbered_postings_.at(it->first).SetImpacts(inverse_document_freq);
+        }
+    }
+    if (it != word_to_postings_.end()) {
+        impact_refresh_cursor_ = std::string{it->first};
+        return false;
+    }
+    impact_refresh_cursor_.clear();
+    is_impact_refresh_running_ = false;
+    return true;
+}
+
+void SearchServer::RefreshImpacts() {
+    while (!RefreshImpacts(std::numeric_limits<std::size_t>::max())) {
+    }
+}
+
+void SearchServer::MaintainImpacts() {
+    if (!impact_drift_threshold_) {
+        return;
+    }
+    if (!is_impact_refresh_running_) {
+        const int drift = std::abs(GetDocumentCount() - impact_document_count_);
+        if (drift <= *impact_drift_threshold_ *
+                         std::max(impact_document_count_, 1)) {
+            return;
+        }
+    }
+    RefreshImpacts(IMPACT_REFRESH_STEP_WORDS);
+}
+
+std::pmr::set<int>::iterator SearchServer::begin() { return document_ids_.begin(); }
+
+std::pmr::set<int>::iterator SearchServer::end() { return document_ids_.end(); }
 
 SearchServer::DocumentContent
 SearchServer::MatchDocument(const std::string_view raw_query,
@@ -57,30 +372,9 @@ SearchServer::MatchDocument(const std::string_view raw_query,
     if (!IsValidWord(raw_query)) {
         throw std::invalid_argument("Некорректный роисковый запрос");
     }
-    const auto query = ParseQuery(raw_query);
-
-    if (std::any_of(query.minus_words.begin(), query.minus_words.end(),
-                    [this, document_id](const std::string_view word) {
-                        if (word_to_document_freqs_.count(word) == 0)
-                            return false;
-                        if (word_to_document_freqs_.at(word).count(document_id))
-                            return true;
-                        return false;
-                    })) {
-        return {{}, documents_.at(document_id).status};
-    }
-    
-    std::vector<std::string_view> matched_words(query.plus_words.size());
-    auto last_word_it = std::copy_if(
-        query.plus_words.begin(), query.plus_words.end(),
-        matched_words.begin(), [this, document_id](const std::string_view word) {
-            if (word_to_document_freqs_.count(word) == 0) return false;
-            if (word_to_document_freqs_.at(word).count(document_id))
-                return true;
-            return false;
-        });
-    matched_words.resize(last_word_it - matched_words.begin());
-    return {matched_words, documents_.at(document_id).status};
+    PreparedQuery query;
+    ResolveQuery(raw_query, query);
+    return MatchDocument(query, document_id);
 }
 
 SearchServer::DocumentContent
@@ -100,36 +394,93 @@ SearchServer::MatchDocument(const std::execution::parallel_policy policy,
     if (!IsValidWord(raw_query)) {
         throw std::invalid_argument("Некорректный роисковый запрос");
     }
-    Query query = ParseQuery(raw_query, true);
-    if (std::any_of(policy, query.minus_words.begin(), query.minus_words.end(),
-                    [this, document_id](const std::string_view word) {
-                        if (word_to_document_freqs_.count(word) == 0)
-                            return false;
-                        if (word_to_document_freqs_.at(word).count(document_id))
-                            return true;
-                        return false;
+    PreparedQuery query;
+    ResolveQuery(raw_query, query);
+    return MatchDocument(policy, query, document_id);
+}
+
+SearchServer::DocumentContent
+SearchServer::MatchDocument(const PreparedQuery& query,
+                            int document_id) const {
+    if (!document_ids_.count(document_id)) {
+        throw std::out_of_range("Передан несуществующий document_id");
+    }
+    if (!IsCurrent(query)) {
+        return MatchDocument(Prepare(query.GetRawQuery()), document_id);
+    }
+    const DocumentStatus status =
+        document_columns_.GetStatus(document_indices_.at(document_id));
+
+    if (std::any_of(query.minus_terms_.begin(), query.minus_terms_.end(),
+                    [document_id](const auto& term) {
+                        return term.document_freqs->count(document_id) > 0;
+                    }) ||
+        query.has_missing_required_term_ ||
+        std::any_of(query.plus_terms_.begin(), query.plus_terms_.end(),
+                    [document_id](const auto& term) {
+                        return term.is_required &&
+                               term.document_freqs->count(document_id) == 0;
+                    })) {
+        return {std::vector<std::string_view>{}, status};
+    }
+
+    std::vector<std::string_view> matched_words;
+    for (const auto& term : query.plus_terms_) {
+        if (term.document_freqs->count(document_id)) {
+            matched_words.push_back(term.word);
+        }
+    }
+    return {matched_words, status};
+}
+
+SearchServer::DocumentContent
+SearchServer::MatchDocument(const std::execution::sequenced_policy,
+                            const PreparedQuery& query,
+                            int document_id) const {
+    return MatchDocument(query, document_id);
+}
+
+SearchServer::DocumentContent
+SearchServer::MatchDocument(const std::execution::parallel_policy policy,
+                            const PreparedQuery& query,
+                            int document_id) const {
+    if (!document_ids_.count(document_id)) {
+        throw std::out_of_range("Передан несуществующий document_id");
+    }
+    if (!IsCurrent(query)) {
+        return MatchDocument(policy, Prepare(query.GetRawQuery()), document_id);
+    }
+    const DocumentStatus status =
+        document_columns_.GetStatus(document_indices_.at(document_id));
+
+    if (std::any_of(policy, query.minus_terms_.begin(), query.minus_terms_.end(),
+                    [document_id](const auto& term) {
+                        return term.document_freqs->count(document_id) > 0;
+                    }) ||
+        query.has_missing_required_term_ ||
+        std::any_of(policy, query.plus_terms_.begin(), query.plus_terms_.end(),
+                    [document_id](const auto& term) {
+                        return term.is_required &&
+                               term.document_freqs->count(document_id) == 0;
                     })) {
-        return {{}, documents_.at(document_id).status};
-    }
-    std::vector<std::string_view> matched_words(query.plus_words.size());
-    auto last_word_it = std::copy_if(
-        policy, query.plus_words.begin(), query.plus_words.end(),
-        matched_words.begin(), [this, document_id](const std::string_view word) {
-            if (word_to_document_freqs_.count(word) == 0) return false;
-            if (word_to_document_freqs_.at(word).count(document_id))
-                return true;
-            return false;
+        return {std::vector<std::string_view>{}, status};
+    }
+    std::vector<std::string_view> matched_words(query.plus_terms_.size());
+    auto last_word_it = std::transform(
+        policy, query.plus_terms_.begin(), query.plus_terms_.end(),
+        matched_words.begin(), [document_id](const auto& term) {
+            return term.document_freqs->count(document_id)
+                       ? term.word
+                       : std::string_view{};
         });
-    matched_words.resize(last_word_it - matched_words.begin());
-    std::sort(matched_words.begin(), matched_words.end());
     matched_words.erase(
-        (std::unique(policy, matched_words.begin(), matched_words.end())),
+        std::remove(matched_words.begin(), last_word_it, std::string_view{}),
         matched_words.end());
-    return {matched_words, documents_.at(document_id).status};
+    return {matched_words, status};
 }
 
 bool SearchServer::IsStopWord(const std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_->count(word) > 0;
 }
 
 bool SearchServer::IsValidWord(const std::string_view word) {
@@ -137,16 +488,15 @@ bool SearchServer::IsValidWord(const std::string_view word) {
                    [](char c) { return c >= '\0' && c < ' '; });
 }
 
-std::vector<std::string> SearchServer::SplitIntoWordsNoStop(
+std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(
     const std::string_view text) const {
-    std::vector<std::string> words;
+    std::vector<std::string_view> words;
     for (const std::string_view word : SplitIntoWordsView(text)) {
-        const std::string string_word = std::string{word};
-        if (!IsValidWord(string_word)) {
-            throw std::invalid_argument("Word "s + string_word + " is invalid"s);
+        if (!IsValidWord(word)) {
+            throw std::invalid_argument("Word "s + std::string{word} + " is invalid"s);
         }
-        if (!IsStopWord(string_word)) {
-            words.push_back(string_word);
+        if (!IsStopWord(word)) {
+            words.push_back(word);
         }
     }
     return words;
@@ -166,47 +516,219 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(
         throw std::invalid_argument("Query word is empty"s);
     }
     bool is_minus = false;
+    bool is_required = false;
     if (text[0] == '-') {
         is_minus = true;
         text = text.substr(1);
+    } else if (text[0] == '+') {
+        is_required = true;
+        text = text.substr(1);
+    }
+    // A single trailing * after a stem and a ~ followed by nothing but
+    // digits are syntax, otherwise both are characters of the word
+    bool is_prefix = false;
+    int max_edits = 0;
+    const auto tilde = text.rfind('~');
+    const std::string_view edits =
+        tilde == text.npos ? std::string_view{} : text.substr(tilde + 1);
+    if (text.size() > 1 && text.back() == '*' && text[text.size() - 2] != '*') {
+        is_prefix = true;
+        text.remove_suffix(1);
+    } else if (tilde != text.npos && tilde > 0 &&
+               std::all_of(edits.begin(), edits.end(),
+                           [](char c) { return c >= '0' && c <= '9'; })) {
+        max_edits = edits.empty() ? 1 : ParseInt(edits);
+        if (max_edits < 1 || max_edits > MAX_FUZZY_EDITS) {
+            throw std::invalid_argument("Query word "s + std::string{text} +
+                                        " allows too many edits"s);
+        }
+        text = text.substr(0, tilde);
     }
-    if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
+    const bool is_expanded = is_prefix || max_edits > 0;
+    if (text.empty() || text[0] == '-' || text[0] == '+' || !IsValidWord(text) ||
+        (is_required && is_expanded)) {
         throw std::invalid_argument("Query word "s + std::string{text} + " is invalid"s);
     }
 
-    return {text, is_minus, IsStopWord(text)};
+    return {text,      is_minus, is_required, !is_expanded && IsStopWord(text),
+            is_prefix, max_edits};
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view text,
-                                             bool parallel) const {
-    Query result;
+std::string SearchServer::GetExpansionKey(const QueryWord& query_word) {
+    return std::string{query_word.data} +
+           (query_word.is_prefix ? "*"s
+                                 : "~"s + std::to_string(query_word.max_edits));
+}
+
+std::vector<WordMatch> SearchServer::ExpandQueryWord(
+    const QueryWord& query_word) const {
+    // Words whose documents were all removed stay in the vocabulary until
+    // Compact and must not take the place of live ones
+    const auto is_live = [this](std::string_view word) {
+        const auto it = word_to_document_freqs_.find(word);
+        return it != word_to_document_freqs_.end() && !it->second.empty();
+    };
+    if (query_word.max_edits > 0) {
+        return term_trie_cache_.ExpandFuzzy(word_to_document_freqs_,
+                                            query_word.data,
+                                            query_word.max_edits,
+                                            MAX_WORD_EXPANSIONS, is_live);
+    }
+    std::vector<WordMatch> matches;
+    for (std::string& word : term_trie_cache_.ExpandPrefix(
+             word_to_document_freqs_, query_word.data, MAX_WORD_EXPANSIONS,
+             is_live)) {
+        matches.push_back({std::move(word), 0});
+    }
+    return matches;
+}
+
+SearchServer::Query SearchServer::ParseQuery(
+    const std::string_view text,
+    const CorpusStats::WordExpansions* word_expansions) const {
+    Query result(GetQueryArena());
  
-    for (const std::string_view word : SplitIntoWordsView(text)) {
+    for (const std::string_view word : SplitIntoWordsView(text, GetQueryArena())) {
         const auto query_word = ParseQueryWord(word);
- 
-        if (!query_word.is_stop) {
+
+        if (query_word.is_prefix || query_word.max_edits > 0) {
+            auto &words =
+                query_word.is_minus ? result.minus_words : result.plus_words;
+            std::vector<WordMatch> own_expansion;
+            const std::vector<WordMatch>* expansion = nullptr;
+            if (word_expansions != nullptr) {
+                const auto it =
+                    word_expansions->find(GetExpansionKey(query_word));
+                if (it != word_expansions->end()) {
+                    expansion = &it->second;
+                }
+            }
+            if (expansion == nullptr) {
+                own_expansion = ExpandQueryWord(query_word);
+                expansion = &own_expansion;
+            }
+            // Views into the term dictionary outlive the expansion. Words
+            // of other servers' expansions may be missing here.
+            const std::size_t word_count =
+                std::min(expansion->size(), MAX_WORD_EXPANSIONS);
+            for (std::size_t i = 0; i < word_count; ++i) {
+                const auto it =
+                    word_to_document_freqs_.find((*expansion)[i].word);
+                if (it != word_to_document_freqs_.end()) {
+                    words.push_back(it->first);
+                }
+            }
+        } else if (!query_word.is_stop) {
             if (query_word.is_minus) {
                 result.minus_words.push_back(query_word.data);
             } else {
                 result.plus_words.push_back(query_word.data);
+                if (query_word.is_required) {
+                    result.required_words.push_back(query_word.data);
+                }
             }
         }
     }
     
-  if(!parallel) {
-      for(auto *words : {&result.plus_words, &result.minus_words}) {
+    for (auto *words : {&result.plus_words, &result.minus_words,
+                        &result.required_words}) {
         std::sort(words->begin(), words->end());
-          words->erase(std::unique(words->begin(), words->end()), words->end());
-      }
-  }  
+        words->erase(std::unique(words->begin(), words->end()), words->end());
+    }
  
     return result;
 }
 
 double SearchServer::ComputeWordInverseDocumentFreq(
-    const std::string_view word) const {
-    return std::log(GetDocumentCount() * 1.0 /
-                    word_to_document_freqs_.at(word).size());
+    const std::pmr::map<int, double>& document_freqs) const {
+    return std::log(GetDocumentCount() * 1.0 / document_freqs.size());
+}
+
+void SearchServer::ResolveQuery(const std::string_view raw_query,
+                                PreparedQuery& query,
+                                const CorpusStats* corpus_stats) const {
+    QueryArenaScope arena_scope;
+    const auto parsed_query = ParseQuery(
+        raw_query,
+        corpus_stats == nullptr ? nullptr : &corpus_stats->word_expansions);
+    query.server_ = this;
+    query.generation_ = generation_.Get();
+    query.plus_terms_.clear();
+    query.minus_terms_.clear();
+    query.is_conjunctive_ = !parsed_query.required_words.empty();
+    query.has_missing_required_term_ = false;
+    query.uses_impacts_ =
+        impact_drift_threshold_.has_value() && corpus_stats == nullptr;
+    for (const std::string_view word : parsed_query.plus_words) {
+        const bool is_required =
+            std::binary_search(parsed_query.required_words.begin(),
+                               parsed_query.required_words.end(), word);
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end() || it->second.empty()) {
+            query.has_missing_required_term_ |= is_required;
+            continue;
+        }
+        double inverse_document_freq = 0.0;
+        if (corpus_stats == nullptr) {
+            // Impacts already include it
+            if (!query.uses_impacts_) {
+                inverse_document_freq = ComputeWordInverseDocumentFreq(it->second);
+            }
+        } else {
+            const auto stats_it = corpus_stats->document_freqs.find(word);
+            if (stats_it == corpus_stats->document_freqs.end() ||
+                stats_it->second == 0) {
+                query.has_missing_required_term_ |= is_required;
+                continue;
+            }
+            inverse_document_freq = std::log(
+                corpus_stats->document_count * 1.0 / stats_it->second);
+        }
+        query.plus_terms_.push_back({it->first, &it->second,
+                                     &word_to_postings_.at(it->first),
+                                     inverse_document_freq, is_required});
+    }
+    for (const std::string_view word : parsed_query.minus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end() || it->second.empty()) {
+            continue;
+        }
+        query.minus_terms_.push_back(
+            {it->first, &it->second, &word_to_postings_.at(it->first), 0.0});
+    }
+
+    if (query.uses_impacts_) {
+        std::uint64_t max_sum = 0;
+        for (const auto& term : query.plus_terms_) {
+            max_sum += term.postings->GetMaxImpact();
+        }
+        if (max_sum > UINT32_MAX) {
+            query.uses_impacts_ = false;
+            for (auto& term : query.plus_terms_) {
+                term.inverse_document_freq =
+                    ComputeWordInverseDocumentFreq(*term.document_freqs);
+            }
+        }
+    }
+}
+
+bool SearchServer::IsCurrent(const PreparedQuery& query) const {
+    return query.server_ == this && query.generation_ == generation_.Get();
+}
+
+std::vector<const PreparedQuery::Term*> SearchServer::GetRequiredTerms(
+    const PreparedQuery& query) {
+    std::vector<const PreparedQuery::Term*> required_terms;
+    for (const auto& term : query.plus_terms_) {
+        if (term.is_required) {
+            required_terms.push_back(&term);
+        }
+    }
+    std::sort(required_terms.begin(), required_terms.end(),
+              [](const auto* lhs, const auto* rhs) {
+                  return lhs->postings->GetSize() < rhs->postings->GetSize();
+              });
+    return required_terms;
 }
 
 const map<string_view, double>& SearchServer::GetWordFrequencies(
@@ -227,13 +749,23 @@ const map<string_view, double>& SearchServer::GetWordFrequencies(
 }
 
 void SearchServer::RemoveDocument(int document_id) {
+    if (document_ids_.count(document_id) == 0) {
+        return;
+    }
+    generation_.Advance();
+    const std::uint32_t document_index = document_indices_.at(document_id);
     document_ids_.erase(document_id);
-    documents_.erase(document_id);
-    for (auto& elem : word_to_document_freqs_) {
-        if (elem.second.count(document_id)) {
-            elem.second.erase(document_id);
+    document_indices_.erase(document_id);
+    document_columns_.Remove(document_index);
+    for (const auto [word, _] : documents_words_freqs_.at(document_id)) {
+        word_to_document_freqs_.at(word).erase(document_id);
+        word_to_postings_.at(word).Remove(document_index);
+        if (IsRenumbered(word)) {
+            renumbered_postings_.at(word).Remove(renumbering_[document_index]);
         }
     }
+    documents_words_freqs_.erase(document_id);
+    MaintainImpacts();
 }
 
 void SearchServer::RemoveDocument(std::execution::sequenced_policy policy,
@@ -246,16 +778,185 @@ void SearchServer::RemoveDocument(std::execution::parallel_policy policy,
     if (document_ids_.count(document_id) == 0) {
         return;
     }
+    generation_.Advance();
+    const std::uint32_t document_index = document_indices_.at(document_id);
     document_ids_.erase(document_id);
-    documents_.erase(document_id);
+    document_indices_.erase(document_id);
+    document_columns_.Remove(document_index);
     auto& document_words = documents_words_freqs_.at(document_id);
     std::vector<std::string_view> words(document_words.size());
     std::transform(
         policy, document_words.begin(), document_words.end(), words.begin(),
         [](const auto& word) { return word.first; });
+    // Tombstones allocate nothing. Erasing map nodes frees them through
+    // the index resource, which need not be thread-safe, so that is done
+    // on this thread.
     std::for_each(
         policy, words.begin(), words.end(),
-        [document_id, &words_frequency = word_to_document_freqs_](auto word) {
-            words_frequency.at(word).erase(document_id);
+        [this, document_index, &words_postings = word_to_postings_](auto word) {
+            words_postings.at(word).Remove(document_index);
+            if (IsRenumbered(word)) {
+                renumbered_postings_.at(word).Remove(
+                    renumbering_[document_index]);
+            }
         });
+    for (const std::string_view word : words) {
+        word_to_document_freqs_.at(word).erase(document_id);
+    }
+    documents_words_freqs_.erase(document_id);
+    MaintainImpacts();
+}
+
+IndexMemoryStats SearchServer::GetMemoryStats() const {
+    IndexMemoryStats stats;
+
+    stats.stop_words = {stop_words_->size(), 0, EstimateNodeBytes(*stop_words_)};
+    for (const std::string& word : *stop_words_) {
+        stats.stop_words.bytes += EstimateHeapBytes(word);
+    }
+    stats.words = term_dictionary_->GetMemoryUsage();
+
+    stats.word_to_document_freqs = {word_to_document_freqs_.size(), 0,
+                                    EstimateNodeBytes(word_to_document_freqs_)};
+    for (const auto& [_, document_freqs] : word_to_document_freqs_) {
+        stats.word_to_document_freqs.nested_entries += document_freqs.size();
+        stats.word_to_document_freqs.bytes += EstimateNodeBytes(document_freqs);
+    }
+    stats.word_to_postings = {word_to_postings_.size(), 0,
+                              EstimateNodeBytes(word_to_postings_)};
+    for (const auto& [_, postings] : word_to_postings_) {
+        stats.word_to_postings.nested_entries += postings.GetSize();
+        stats.word_to_postings.bytes += postings.GetMemoryBytes();
+        if (postings.IsEmpty()) {
+            ++stats.empty_posting_lists;
+        }
+        stats.posting_tombstones += postings.GetTombstoneCount();
+    }
+    // Copies made by a running renumbering and lists it replaced
+    for (const auto* word_postings : {&renumbered_postings_, &retired_postings_}) {
+        stats.word_to_postings.bytes += EstimateNodeBytes(*word_postings);
+        for (const auto& [_, postings] : *word_postings) {
+            stats.word_to_postings.bytes += postings.GetMemoryBytes();
+        }
+    }
+    stats.documents_words_freqs = {documents_words_freqs_.size(), 0,
+                                   EstimateNodeBytes(documents_words_freqs_)};
+    for (const auto& [_, word_freqs] : documents_words_freqs_) {
+        stats.documents_words_freqs.nested_entries += word_freqs.size();
+        stats.documents_words_freqs.bytes += EstimateNodeBytes(word_freqs);
+    }
+
+    stats.documents = {document_columns_.GetSize(), 0,
+                       EstimateNodeBytes(document_indices_) +
+                           EstimateNodeBytes(document_ids_) +
+                           document_columns_.GetMemoryBytes()};
+    stats.dead_document_indices =
+        document_columns_.GetSize() - document_indices_.size();
+
+    for (const MemoryUsage* usage :
+         {&stats.stop_words, &stats.words, &stats.word_to_document_freqs,
+          &stats.word_to_postings, &stats.documents_words_freqs,
+          &stats.documents}) {
+        stats.total += *usage;
+    }
+    return stats;
+}
+
+bool SearchServer::Compact(std::size_t max_words) {
+    // Lists replaced by the last renumbering go first, they key views of
+    // words the first phase may release
+    for (; max_words > 0 && !retired_postings_.empty(); --max_words) {
+        retired_postings_.erase(retired_postings_.begin());
+    }
+    if (!retired_postings_.empty()) {
+        return false;
+    }
+    if (is_renumbering_) {
+        return ContinueRenumbering(max_words);
+    }
+
+    auto it = word_to_postings_.lower_bound(compact_cursor_);
+    for (std::size_t examined = 0;
+         it != word_to_postings_.end() && examined < max_words; ++examined) {
+        PostingList& postings = it->second;
+        if (!postings.IsEmpty()) {
+            if (postings.GetTombstoneCount() > postings.GetSize()) {
+                postings.Renumber([this](std::uint32_t index) {
+                    return document_columns_.IsAlive(index) ? index
+                                                            : DEAD_DOCUMENT_INDEX;
+                });
+            }
+            postings.ShrinkToFit();
+            ++it;
+            continue;
+        }
+        // The dictionary's string owns the map keys, so it goes last
+        const std::string_view word = it->first;
+        word_to_document_freqs_.erase(word);
+        it = word_to_postings_.erase(it);
+        term_dictionary_->Release(word);
+        term_trie_cache_.Invalidate();
+        generation_.Advance();
+    }
+    if (it != word_to_postings_.end()) {
+        compact_cursor_ = std::string{it->first};
+        return false;
+    }
+    compact_cursor_.clear();
+
+    // Renumbering touches every posting, doing it only when dead indices
+    // outnumber live ones keeps its cost amortized over the removals
+    if (document_columns_.GetSize() - document_indices_.size() >
+        document_indices_.size()) {
+        renumbering_ = document_columns_.GetCompactIndices();
+        renumbered_document_count_ =
+            static_cast<std::uint32_t>(document_indices_.size());
+        is_renumbering_ = true;
+        return false;
+    }
+    return true;
+}
+
+bool SearchServer::ContinueRenumbering(std::size_t max_words) {
+    // Documents removed since the renumbering started are dropped here,
+    // or left as tombstones once their lists are copied
+    const auto new_index = [this](std::uint32_t index) {
+        return document_columns_.IsAlive(index) ? renumbering_[index]
+                                                : DEAD_DOCUMENT_INDEX;
+    };
+    auto it = word_to_postings_.lower_bound(compact_cursor_);
+    for (std::size_t copied = 0;
+         it != word_to_postings_.end() && copied < max_words;
+         ++it, ++copied) {
+        renumbered_postings_.emplace(it->first, it->second)
+            .first->second.Renumber(new_index);
+    }
+    if (it != word_to_postings_.end()) {
+        compact_cursor_ = std::string{it->first};
+        return false;
+    }
+    compact_cursor_.clear();
+
+    // Every list has its copy; switching costs O(documents), not O(postings)
+    document_columns_.Compact(renumbering_);
+    for (auto& [document_id, document_index] : document_indices_) {
+        document_index = renumbering_[document_index];
+    }
+    word_to_postings_.swap(renumbered_postings_);
+    retired_postings_.swap(renumbered_postings_);
+    renumbering_.clear();
+    renumbering_.shrink_to_fit();
+    is_renumbering_ = false;
+    generation_.Advance();
+    return true;
+}
+
+bool SearchServer::IsRenumbered(const std::string_view word) const {
+    return is_renumbering_ && word < compact_cursor_;
+}
+
+void SearchServer::Compact() {
+    while (!Compact(std::numeric_limits<std::size_t>::max())) {
+    }
+    retired_postings_.clear();
 }
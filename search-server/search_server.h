@@ -1,35 +1,127 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <execution>
+#include <future>
 #include <map>
+#include <memory_resource>
 #include <numeric>
+#include <optional>
 #include <set>
 #include <stdexcept>
 #include <vector>
 
 #include "concurrent_map.h"
+#include "corpus_stats.h"
 #include "document.h"
+#include "document_columns.h"
+#include "document_filter.h"
+#include "memory_stats.h"
+#include "posting_list.h"
+#include "prepared_query.h"
+#include "query_arena.h"
+#include "query_plan.h"
 #include "read_input_functions.h"
+#include "scoring_kernels.h"
+#include "search_budget.h"
 #include "string_processing.h"
+#include "term_dictionary.h"
+#include "term_trie.h"
 
 using namespace std;
 
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double EPS = 1e-6;
+// Deployments may override these when building
+#ifndef SEARCH_SERVER_MAX_RESULT_DOCUMENT_COUNT
+#define SEARCH_SERVER_MAX_RESULT_DOCUMENT_COUNT 5
+#endif
+#ifndef SEARCH_SERVER_EPS
+#define SEARCH_SERVER_EPS 1e-6
+#endif
+
+constexpr int MAX_RESULT_DOCUMENT_COUNT = SEARCH_SERVER_MAX_RESULT_DOCUMENT_COUNT;
+constexpr double EPS = SEARCH_SERVER_EPS;
+static_assert(MAX_RESULT_DOCUMENT_COUNT > 0 && EPS >= 0.0,
+              "Invalid search result limits");
+// Limits of word* and word~N query words
+const std::size_t MAX_WORD_EXPANSIONS = 32;
+const int MAX_FUZZY_EDITS = 2;
+
+// Result order: by relevance, by rating when relevance is within EPS
+inline bool IsRankedHigher(const Document &lhs, const Document &rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < EPS) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
 
 class SearchServer {
    public:
-    explicit SearchServer(const std::string &stop_words_text);
-    explicit SearchServer(const std::string_view stop_words_text);
+    // resource holds the index and must outlive the server
+    explicit SearchServer(const std::string &stop_words_text,
+                          std::pmr::memory_resource *resource =
+                              std::pmr::get_default_resource());
+    explicit SearchServer(const std::string_view stop_words_text,
+                          std::pmr::memory_resource *resource =
+                              std::pmr::get_default_resource());
 
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer &stop_words);
+    explicit SearchServer(const StringContainer &stop_words,
+                          std::pmr::memory_resource *resource =
+                              std::pmr::get_default_resource());
+
+    // Servers given the same stop words and dictionary store every word
+    // once between them; the dictionary itself does not use resource
+    SearchServer(std::shared_ptr<const StopWordSet> stop_words,
+                 std::shared_ptr<TermDictionary> term_dictionary,
+                 std::pmr::memory_resource *resource =
+                     std::pmr::get_default_resource());
+
+    // The copy shares the stop words and the term dictionary and takes a
+    // reference to each word of its vocabulary. Like std::pmr containers,
+    // it allocates from the default resource.
+    SearchServer(const SearchServer &other);
+    SearchServer(SearchServer &&other) = default;
+
+    // Index keys are references into the term dictionary of the server
+    SearchServer &operator=(const SearchServer &) = delete;
+    SearchServer &operator=(SearchServer &&) = delete;
+
+    ~SearchServer();
 
     void AddDocument(int document_id, const std::string_view document,
                      DocumentStatus status, const std::vector<int> &ratings);
 
+    // Distinct non-stop words of a document with their term frequencies,
+    // viewing the tokenized text
+    using DocumentTerms = std::vector<std::pair<std::string_view, double>>;
+
+    // Only reads the stop words, so documents can be tokenized in parallel
+    // with each other and with AddDocument
+    DocumentTerms TokenizeDocument(const std::string_view document) const;
+
+    void AddDocument(int document_id, const DocumentTerms &document_terms,
+                     DocumentStatus status, const std::vector<int> &ratings);
+
+    PreparedQuery Prepare(const std::string_view raw_query) const;
+
+    // Scores with IDF from corpus_stats instead of this server's index.
+    // Once stale, the query is re-prepared with local statistics.
+    PreparedQuery Prepare(const std::string_view raw_query,
+                          const CorpusStats &corpus_stats) const;
+
+    // Document count, frequencies of the query's plus words and the
+    // expansions of its word* and word~N terms
+    CorpusStats GetCorpusStats(const std::string_view raw_query) const;
+
+    // Same, with the terms expanded as in word_expansions, for instance
+    // merged from every shard of a corpus
+    CorpusStats GetCorpusStats(
+        const std::string_view raw_query,
+        const CorpusStats::WordExpansions &word_expansions) const;
+
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(
         const std::string_view raw_query,
@@ -57,11 +149,122 @@ class SearchServer {
         const Policy policy,
         const std::string_view raw_query) const;
 
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query,
+                                           const DocumentFilter &filter) const;
+
+    template <typename Policy>
+    std::vector<Document> FindTopDocuments(
+        const Policy policy,
+        const std::string_view raw_query, const DocumentFilter &filter) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+        const PreparedQuery &query,
+        DocumentPredicate document_predicate) const;
+
+    template <typename Policy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+        const Policy policy,
+        const PreparedQuery &query,
+        DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery &query,
+                                           DocumentStatus status) const;
+
+    template <typename Policy>
+    std::vector<Document> FindTopDocuments(
+        const Policy policy,
+        const PreparedQuery &query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery &query) const;
+
+    template <typename Policy>
+    std::vector<Document> FindTopDocuments(
+        const Policy policy,
+        const PreparedQuery &query) const;
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery &query,
+                                           const DocumentFilter &filter) const;
+
+    template <typename Policy>
+    std::vector<Document> FindTopDocuments(
+        const Policy policy,
+        const PreparedQuery &query, const DocumentFilter &filter) const;
+
+    // Scoring stops once budget expires and the result is flagged partial
+    template <typename Policy, typename DocumentPredicate>
+    SearchResult FindTopDocuments(const Policy policy,
+                                  const PreparedQuery &query,
+                                  DocumentPredicate document_predicate,
+                                  SearchBudget &budget) const;
+
+    template <typename Policy>
+    SearchResult FindTopDocuments(const Policy policy,
+                                  const PreparedQuery &query,
+                                  DocumentStatus status,
+                                  SearchBudget &budget) const;
+
+    template <typename Policy>
+    SearchResult FindTopDocuments(const Policy policy,
+                                  const PreparedQuery &query,
+                                  const DocumentFilter &filter,
+                                  SearchBudget &budget) const;
+
+    // Searches on a separate thread. time_budget counts from the call, and
+    // token may cancel the search at any time. The server must not be
+    // modified until the future is ready.
+    template <typename DocumentPredicate>
+    std::future<SearchResult> FindTopDocumentsAsync(
+        const std::string_view raw_query,
+        DocumentPredicate document_predicate,
+        std::chrono::steady_clock::duration time_budget,
+        CancellationToken token = {}) const;
+
+    std::future<SearchResult> FindTopDocumentsAsync(
+        const std::string_view raw_query, DocumentStatus status,
+        std::chrono::steady_clock::duration time_budget,
+        CancellationToken token = {}) const;
+
+    std::future<SearchResult> FindTopDocumentsAsync(
+        const std::string_view raw_query, const DocumentFilter &filter,
+        std::chrono::steady_clock::duration time_budget,
+        CancellationToken token = {}) const;
+
+    std::future<SearchResult> FindTopDocumentsAsync(
+        const std::string_view raw_query,
+        std::chrono::steady_clock::duration time_budget,
+        CancellationToken token = {}) const;
+
     int GetDocumentCount() const;
 
-    std::set<int>::iterator begin();
+    // Changes on every AddDocument/RemoveDocument, never repeats a value
+    // of any server
+    std::uint64_t GetGeneration() const;
+
+    // Kernel used by sequential scoring, the widest supported by default
+    void SetScoringIsa(ScoringIsa isa);
+    ScoringIsa GetScoringIsa() const;
+
+    // Postings keep quantized tf-idf impacts, and queries sum them as
+    // integers instead of multiplying term frequencies by IDF. Impacts use
+    // the IDF of the moment they are computed. Once the document count
+    // drifts from the one of the last refresh by more than drift_threshold
+    // of it, every AddDocument and RemoveDocument refreshes a few words
+    // until a full pass is done. Queries prepared with CorpusStats keep
+    // exact scoring.
+    void EnableImpactScoring(double drift_threshold = 0.1);
+    void DisableImpactScoring();
+    bool IsImpactScoringEnabled() const;
+
+    // Recomputes impacts of at most max_words words with the current IDF,
+    // starting a pass if none is running; returns true when a pass is
+    // finished. Like Compact, must not run concurrently with queries.
+    bool RefreshImpacts(std::size_t max_words);
+    void RefreshImpacts();
 
-    std::set<int>::iterator end();
+    std::pmr::set<int>::iterator begin();
+
+    std::pmr::set<int>::iterator end();
 
     using DocumentContent = std::tuple<std::vector<std::string_view>, DocumentStatus>;
     
@@ -76,6 +279,17 @@ class SearchServer {
         const std::execution::parallel_policy policy,
         const std::string_view raw_query, int document_id) const;
 
+    DocumentContent MatchDocument(
+        const PreparedQuery &query, int document_id) const;
+
+    DocumentContent MatchDocument(
+        const std::execution::sequenced_policy policy,
+        const PreparedQuery &query, int document_id) const;
+
+    DocumentContent MatchDocument(
+        const std::execution::parallel_policy policy,
+        const PreparedQuery &query, int document_id) const;
+
     const std::map<std::string_view, double> &GetWordFrequencies(
         int document_id) const;
 
@@ -85,68 +299,229 @@ class SearchServer {
     void RemoveDocument(const std::execution::parallel_policy policy,
                         int document_id);
 
+    IndexMemoryStats GetMemoryStats() const;
+
+    // Drops words left without documents and purges tombstones of removed
+    // documents from posting lists they crowd. Once removed documents hold
+    // most internal indices, renumbers them: posting lists are copied
+    // renumbered a few per call and swapped in together at the end of the
+    // pass. Examines or copies at most max_words lists per call, so it can
+    // be interleaved with queries and document updates; returns true when
+    // a full pass is finished.
+    bool Compact(std::size_t max_words);
+    void Compact();
+
    private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
+    // Stamp of the index state that no server ever reuses: every server,
+    // copy, move and index change takes a fresh value from a process-wide
+    // counter. A query prepared on a destroyed server thus never passes as
+    // current on another one built at the same address.
+    class IndexGeneration {
+       public:
+        IndexGeneration() : value_(Next()) {}
+
+        IndexGeneration(const IndexGeneration &) : value_(Next()) {}
+
+        IndexGeneration(IndexGeneration &&other) noexcept : value_(Next()) {
+            other.Advance();
+        }
+
+        IndexGeneration &operator=(const IndexGeneration &) = delete;
+
+        void Advance() { value_ = Next(); }
+
+        std::uint64_t Get() const { return value_; }
+
+       private:
+        std::uint64_t value_;
+
+        static std::uint64_t Next();
     };
-    const std::set<std::string, std::less<>> stop_words_;
-    std::set<std::string> documents_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> documents_words_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+
+    const std::shared_ptr<const StopWordSet> stop_words_;
+    // Owns the words; the server holds a reference to each key of
+    // word_to_document_freqs_, which lists its whole vocabulary
+    const std::shared_ptr<TermDictionary> term_dictionary_;
+    std::pmr::map<std::string_view, std::pmr::map<int, double>>
+        word_to_document_freqs_;
+    std::pmr::map<std::string_view, PostingList> word_to_postings_;
+    std::pmr::map<int, std::pmr::map<std::string_view, double>>
+        documents_words_freqs_;
+    // Internal indices are assigned in insertion order and never reused
+    std::pmr::map<int, std::uint32_t> document_indices_;
+    DocumentColumns document_columns_;
+    std::pmr::set<int> document_ids_;
+    IndexGeneration generation_;
+    // First word the next Compact step examines or renumbers
+    std::string compact_cursor_;
+    // Set while Compact renumbers internal indices
+    bool is_renumbering_ = false;
+    // New index of every internal index, DEAD_DOCUMENT_INDEX for documents
+    // removed before the renumbering started
+    std::vector<std::uint32_t> renumbering_;
+    std::uint32_t renumbered_document_count_ = 0;
+    // Renumbered copies of the posting lists of the words before
+    // compact_cursor_, kept up to date by document updates
+    std::pmr::map<std::string_view, PostingList> renumbered_postings_;
+    // Lists replaced by the last renumbering, freed by later Compact steps
+    std::pmr::map<std::string_view, PostingList> retired_postings_;
+    // Over word_to_document_freqs_, for word* and word~N
+    TermTrieCache term_trie_cache_;
+    ScoringIsa scoring_isa_ = DetectScoringIsa();
+    AccumulateKernel accumulate_kernel_ = GetAccumulateKernel(scoring_isa_);
+    // Set while impact scoring is enabled
+    std::optional<double> impact_drift_threshold_;
+    // Document count when the last impact refresh pass started
+    int impact_document_count_ = 0;
+    bool is_impact_refresh_running_ = false;
+    // First word the next RefreshImpacts step recomputes
+    std::string impact_refresh_cursor_;
+
+    // Words an automatic refresh step recomputes per document update
+    static constexpr std::size_t IMPACT_REFRESH_STEP_WORDS = 256;
+    // Sequential scoring goes sparse when the plus words' postings number
+    // less than 1/SPARSE_SCORING_RATIO of the internal document indices
+    static constexpr std::size_t SPARSE_SCORING_RATIO = 128;
 
     bool IsStopWord(const std::string_view word) const;
 
     static bool IsValidWord(const std::string_view word);
 
-    std::vector<std::string> SplitIntoWordsNoStop(
+    std::vector<std::string_view> SplitIntoWordsNoStop(
         const std::string_view text) const;
 
     static int ComputeAverageRating(const std::vector<int> &ratings);
 
+    // Runs a refresh step if impacts have drifted, after a document update
+    void MaintainImpacts();
+
+    // The word's posting list has a renumbered copy to keep up to date
+    bool IsRenumbered(const std::string_view word) const;
+
+    // Renumbering step of Compact
+    bool ContinueRenumbering(std::size_t max_words);
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
+        bool is_required;
         bool is_stop;
+        // word*: every word starting with data
+        bool is_prefix;
+        // word~N: every word within max_edits edits of data
+        int max_edits;
     };
 
     QueryWord ParseQueryWord(const std::string_view text) const;
 
+    // Key of a word* or word~N term in CorpusStats::word_expansions
+    static std::string GetExpansionKey(const QueryWord &query_word);
+
+    // Live words of the index a word* or word~N term stands for, at most
+    // MAX_WORD_EXPANSIONS
+    std::vector<WordMatch> ExpandQueryWord(const QueryWord &query_word) const;
+
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        explicit Query(std::pmr::memory_resource *resource)
+            : plus_words(resource),
+              minus_words(resource),
+              required_words(resource) {}
+
+        std::pmr::vector<std::string_view> plus_words;
+        std::pmr::vector<std::string_view> minus_words;
+        // Also listed in plus_words
+        std::pmr::vector<std::string_view> required_words;
     };
 
-    Query ParseQuery(const std::string_view text, bool parallel = false) const;
-    // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    // Query words are allocated from the query arena. Terms found in
+    // word_expansions take those words instead of this index's own.
+    Query ParseQuery(
+        const std::string_view text,
+        const CorpusStats::WordExpansions *word_expansions = nullptr) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(
-        const Query &query, DocumentPredicate document_predicate) const;
+    double ComputeWordInverseDocumentFreq(
+        const std::pmr::map<int, double> &document_freqs) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(
-        const std::execution::sequenced_policy policy, const Query &query,
-        DocumentPredicate document_predicate) const;
+    // Fills query terms; raw_query is only parsed, not stored
+    void ResolveQuery(const std::string_view raw_query, PreparedQuery &query,
+                      const CorpusStats *corpus_stats = nullptr) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(
-        const std::execution::parallel_policy policy, const Query &query,
-        DocumentPredicate document_predicate) const;
+    bool IsCurrent(const PreparedQuery &query) const;
+
+    template <typename Policy>
+    static std::vector<Document> SelectTopDocuments(
+        const Policy policy, std::pmr::vector<Document> matched_documents);
+
+    // FindAllDocuments and ScoreDocuments allocate from the query arena.
+    // A budget, if given, is checked before every posting block.
+    template <typename Policy, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocuments(
+        const Policy policy, const PreparedQuery &query,
+        DocumentPredicate document_predicate,
+        SearchBudget *budget = nullptr) const;
+
+    template <typename Policy>
+    std::pmr::vector<Document> FindAllDocuments(
+        const Policy policy, const PreparedQuery &query,
+        const DocumentFilter &filter, SearchBudget *budget = nullptr) const;
+
+    // DocumentAcceptor takes an internal document index and must reject
+    // removed documents, whose postings may linger as tombstones
+    template <typename DocumentAcceptor>
+    std::pmr::vector<Document> ScoreDocuments(
+        const std::execution::sequenced_policy policy,
+        const PreparedQuery &query, DocumentAcceptor accept_document,
+        SearchBudget *budget) const;
+
+    template <typename DocumentAcceptor>
+    std::pmr::vector<Document> ScoreDocuments(
+        const std::execution::parallel_policy policy,
+        const PreparedQuery &query, DocumentAcceptor accept_document,
+        SearchBudget *budget) const;
+
+    // Sorts the postings' contributions by document instead of zeroing
+    // arrays sized to the index, so a selective query costs O(p log p) in
+    // its posting count p whatever the index size
+    template <typename DocumentAcceptor>
+    std::pmr::vector<Document> ScoreSparseDocuments(
+        const PreparedQuery &query, DocumentAcceptor &accept_document,
+        std::size_t posting_count, SearchBudget *budget) const;
+
+    // Required terms, rarest first
+    static std::vector<const PreparedQuery::Term *> GetRequiredTerms(
+        const PreparedQuery &query);
+
+    // Conjunctive scoring: the rarest required list is walked one posting
+    // block at a time, the other required and the minus lists are
+    // intersected with it by galloping, and only documents that survive
+    // are scored
+    template <typename DocumentAcceptor>
+    std::pmr::vector<Document> ScoreRequiredDocuments(
+        const std::execution::sequenced_policy policy,
+        const PreparedQuery &query, DocumentAcceptor &accept_document,
+        SearchBudget *budget) const;
+
+    template <typename DocumentAcceptor>
+    std::pmr::vector<Document> ScoreRequiredDocuments(
+        const std::execution::parallel_policy policy,
+        const PreparedQuery &query, DocumentAcceptor &accept_document,
+        SearchBudget *budget) const;
+
+    // Appends the matching documents of one block of the rarest list
+    template <typename DocumentAcceptor, typename Documents>
+    void ScoreRequiredBlock(
+        const PreparedQuery &query,
+        const std::vector<const PreparedQuery::Term *> &required_terms,
+        std::size_t block, DocumentAcceptor &accept_document,
+        Documents &matched_documents) const;
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer &stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(
-          stop_words))  // Extract non-empty stop words
-{
-    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
-        throw std::invalid_argument("Some of stop words are invalid"s);
-    }
-}
+SearchServer::SearchServer(const StringContainer &stop_words,
+                           std::pmr::memory_resource *resource)
+    : SearchServer(MakeStopWordSet(stop_words),  // Extract non-empty stop words
+                   std::make_shared<TermDictionary>(), resource)
+{}
 
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(
@@ -160,33 +535,52 @@ template <typename Policy, typename DocumentPredicate>
         const Policy policy,
         const std::string_view raw_query,
         DocumentPredicate document_predicate) const {
-    
-    const auto query = ParseQuery(raw_query, typeid(policy) == typeid(std::execution::par));
-
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-
-    sort(policy, matched_documents.begin(), matched_documents.end(),
-         [](const Document &lhs, const Document &rhs) {
-             if (abs(lhs.relevance - rhs.relevance) < EPS) {
-                 return lhs.rating > rhs.rating;
-             } else {
-                 return lhs.relevance > rhs.relevance;
-             }
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    PreparedQuery query;
+    ResolveQuery(raw_query, query);
+    return FindTopDocuments(policy, query, document_predicate);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(
+    const PreparedQuery &query,
+    DocumentPredicate document_predicate) const {
+    return FindTopDocuments(std::execution::seq, query, document_predicate);
+}
+
+template <typename Policy, typename DocumentPredicate>
+    std::vector<Document> SearchServer::FindTopDocuments(
+        const Policy policy,
+        const PreparedQuery &query,
+        DocumentPredicate document_predicate) const {
+    if (!IsCurrent(query)) {
+        return FindTopDocuments(policy, Prepare(query.GetRawQuery()),
+                                document_predicate);
     }
+    QueryArenaScope arena_scope;
 
-    return matched_documents;
+    return SelectTopDocuments(
+        policy, FindAllDocuments(policy, query, document_predicate));
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::SelectTopDocuments(
+    const Policy policy, std::pmr::vector<Document> matched_documents) {
+    // Only the returned head needs ordering
+    const auto top_end =
+        matched_documents.begin() +
+        std::min<std::size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(policy, matched_documents.begin(), top_end,
+                      matched_documents.end(), IsRankedHigher);
+    matched_documents.erase(top_end, matched_documents.end());
+
+    return {matched_documents.begin(), matched_documents.end()};
 }
 
 template <typename Policy>
 std::vector<Document> SearchServer::FindTopDocuments(
         const Policy policy,
         const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy,
-        raw_query, [status](int document_id, DocumentStatus document_status,
-                            int rating) { return document_status == status; });
+    return FindTopDocuments(policy, raw_query, DocumentFilter(status));
 }
 
 template <typename Policy>
@@ -196,95 +590,454 @@ std::vector<Document> SearchServer::FindTopDocuments(
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(
+        const Policy policy,
+        const std::string_view raw_query, const DocumentFilter &filter) const {
+    PreparedQuery query;
+    ResolveQuery(raw_query, query);
+    return FindTopDocuments(policy, query, filter);
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(
+        const Policy policy,
+        const PreparedQuery &query, DocumentStatus status) const {
+    return FindTopDocuments(policy, query, DocumentFilter(status));
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(
+        const Policy policy,
+        const PreparedQuery &query) const {
+    return FindTopDocuments(policy, query, DocumentStatus::ACTUAL);
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(
+        const Policy policy,
+        const PreparedQuery &query, const DocumentFilter &filter) const {
+    if (!IsCurrent(query)) {
+        return FindTopDocuments(policy, Prepare(query.GetRawQuery()), filter);
+    }
+    QueryArenaScope arena_scope;
+    return SelectTopDocuments(policy, FindAllDocuments(policy, query, filter));
+}
+
+template <typename Policy, typename DocumentPredicate>
+SearchResult SearchServer::FindTopDocuments(const Policy policy,
+                                            const PreparedQuery &query,
+                                            DocumentPredicate document_predicate,
+                                            SearchBudget &budget) const {
+    if (!IsCurrent(query)) {
+        return FindTopDocuments(policy, Prepare(query.GetRawQuery()),
+                                document_predicate, budget);
+    }
+    QueryArenaScope arena_scope;
+    std::vector<Document> documents = SelectTopDocuments(
+        policy, FindAllDocuments(policy, query, document_predicate, &budget));
+    return {std::move(documents), budget.IsExpired()};
+}
+
+template <typename Policy>
+SearchResult SearchServer::FindTopDocuments(const Policy policy,
+                                            const PreparedQuery &query,
+                                            DocumentStatus status,
+                                            SearchBudget &budget) const {
+    return FindTopDocuments(policy, query, DocumentFilter(status), budget);
+}
+
+template <typename Policy>
+SearchResult SearchServer::FindTopDocuments(const Policy policy,
+                                            const PreparedQuery &query,
+                                            const DocumentFilter &filter,
+                                            SearchBudget &budget) const {
+    if (!IsCurrent(query)) {
+        return FindTopDocuments(policy, Prepare(query.GetRawQuery()), filter,
+                                budget);
+    }
+    QueryArenaScope arena_scope;
+    std::vector<Document> documents = SelectTopDocuments(
+        policy, FindAllDocuments(policy, query, filter, &budget));
+    return {std::move(documents), budget.IsExpired()};
+}
+
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(
-    const SearchServer::Query &query,
-    DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        const double inverse_document_freq =
-            ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] :
-             word_to_document_freqs_.at(word)) {
-            const auto &document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status,
-                                   document_data.rating)) {
-                document_to_relevance[document_id] +=
-                    term_freq * inverse_document_freq;
-            }
+std::future<SearchResult> SearchServer::FindTopDocumentsAsync(
+    const std::string_view raw_query, DocumentPredicate document_predicate,
+    std::chrono::steady_clock::duration time_budget,
+    CancellationToken token) const {
+    const auto deadline = std::chrono::steady_clock::now() + time_budget;
+    return std::async(
+        std::launch::async,
+        [this, raw_query = std::string(raw_query), document_predicate, deadline,
+         token = std::move(token)] {
+            SearchBudget budget(deadline, token);
+            return FindTopDocuments(std::execution::seq, Prepare(raw_query),
+                                    document_predicate, budget);
+        });
+}
+
+template <typename Policy, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(
+    const Policy policy, const PreparedQuery &query,
+    DocumentPredicate document_predicate, SearchBudget *budget) const {
+    return ScoreDocuments(
+        GetScoringPolicy(policy), query,
+        [this, &document_predicate](const std::uint32_t document_index) {
+            return document_columns_.IsAlive(document_index) &&
+                   document_predicate(
+                       document_columns_.GetId(document_index),
+                       document_columns_.GetStatus(document_index),
+                       document_columns_.GetRating(document_index));
+        },
+        budget);
+}
+
+template <typename Policy>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(
+    const Policy policy, const PreparedQuery &query,
+    const DocumentFilter &filter, SearchBudget *budget) const {
+    const CompiledFilter compiled_filter(filter, document_columns_,
+                                         GetQueryArena());
+    return ScoreDocuments(GetScoringPolicy(policy), query,
+                          [&compiled_filter](const std::uint32_t document_index) {
+                              return compiled_filter.Accepts(document_index);
+                          },
+                          budget);
+}
+
+template <typename DocumentAcceptor>
+std::pmr::vector<Document> SearchServer::ScoreDocuments(
+    const std::execution::sequenced_policy policy, const PreparedQuery &query,
+    DocumentAcceptor accept_document, SearchBudget *budget) const {
+    if (query.is_conjunctive_) {
+        return ScoreRequiredDocuments(policy, query, accept_document, budget);
+    }
+    std::size_t posting_count = 0;
+    for (const auto &term : query.plus_terms_) {
+        posting_count += term.postings->GetSize();
+    }
+    if (posting_count * SPARSE_SCORING_RATIO < document_columns_.GetSize()) {
+        return ScoreSparseDocuments(query, accept_document, posting_count,
+                                    budget);
+    }
+    std::pmr::memory_resource *arena = GetQueryArena();
+    enum : char { UNSEEN, ACCEPTED, REJECTED };
+    std::pmr::vector<char> document_states(document_columns_.GetSize(), UNSEEN,
+                                           arena);
+    for (const auto &term : query.minus_terms_) {
+        for (const std::uint32_t document_index :
+             term.postings->GetDocumentIndices()) {
+            document_states[document_index] = REJECTED;
         }
     }
 
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+    // Acceptance is decided once per document, the kernel runs per block.
+    // Minus words are applied in full even on a tight budget.
+    std::pmr::vector<double> relevance(
+        query.uses_impacts_ ? 0 : document_columns_.GetSize(), arena);
+    std::pmr::vector<std::uint32_t> impact_sums(
+        query.uses_impacts_ ? document_columns_.GetSize() : 0, arena);
+    std::pmr::vector<std::uint32_t> candidates(arena);
+    for (const auto &term : query.plus_terms_) {
+        const PostingList &postings = *term.postings;
+        for (std::size_t block = 0; block < postings.GetBlockCount(); ++block) {
+            if (budget != nullptr && budget->CheckExpired()) {
+                break;
+            }
+            const PostingBlock postings_block = postings.GetBlock(block);
+            for (std::size_t i = 0; i < postings_block.size; ++i) {
+                const std::uint32_t document_index =
+                    postings_block.document_indices[i];
+                char &state = document_states[document_index];
+                if (state != UNSEEN) {
+                    continue;
+                }
+                if (accept_document(document_index)) {
+                    state = ACCEPTED;
+                    candidates.push_back(document_index);
+                } else {
+                    state = REJECTED;
+                }
+            }
+            if (query.uses_impacts_) {
+                AccumulateImpacts(postings_block.document_indices,
+                                  postings_block.impacts, postings_block.size,
+                                  impact_sums.data());
+            } else {
+                accumulate_kernel_(postings_block.document_indices,
+                                   postings_block.term_freqs, postings_block.size,
+                                   term.inverse_document_freq, relevance.data());
+            }
         }
     }
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
+    std::pmr::vector<Document> matched_documents(arena);
+    matched_documents.reserve(candidates.size());
+    for (const std::uint32_t document_index : candidates) {
         matched_documents.push_back(
-            {document_id, relevance, documents_.at(document_id).rating});
+            {document_columns_.GetId(document_index),
+             query.uses_impacts_ ? impact_sums[document_index] * IMPACT_UNIT
+                                 : relevance[document_index],
+             document_columns_.GetRating(document_index)});
     }
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(
-    const std::execution::sequenced_policy policy, const Query &query,
-    DocumentPredicate document_predicate) const {
-    return FindAllDocuments(query, document_predicate);
-}
+template <typename DocumentAcceptor>
+std::pmr::vector<Document> SearchServer::ScoreDocuments(
+    const std::execution::parallel_policy policy, const PreparedQuery &query,
+    DocumentAcceptor accept_document, SearchBudget *budget) const {
+    if (query.is_conjunctive_) {
+        return ScoreRequiredDocuments(policy, query, accept_document, budget);
+    }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(
-    const std::execution::parallel_policy policy, const Query &query,
-    DocumentPredicate document_predicate) const {
-    
-    std::vector<std::string_view> plus_words = query.plus_words;
-    std::sort(plus_words.begin(), plus_words.end());
-    plus_words.erase(
-        (std::unique(policy, plus_words.begin(), plus_words.end())),
-        plus_words.end());
-    
-    ConcurrentMap<int, double> document_to_relevance_cm(8);
+    ConcurrentMap<std::uint32_t, double> document_to_relevance_cm(8);
 
     std::for_each(policy, 
-                  plus_words.begin(), 
-                  plus_words.end(), 
-                  [this, &policy, &document_to_relevance_cm, document_predicate](const std::string_view& word) {
-        if (word_to_document_freqs_.count(word) == 0) return;
-
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-
-        const auto& word_to_doc_freq = word_to_document_freqs_.at(word);
-        std::for_each(policy, word_to_doc_freq.begin(), word_to_doc_freq.end(), [inverse_document_freq, this, &document_to_relevance_cm, document_predicate](const auto& doc_freq){
-            const auto& document_data = documents_.at(doc_freq.first);
-            if (document_predicate(doc_freq.first, document_data.status, document_data.rating)) {
-                document_to_relevance_cm[doc_freq.first].ref_to_value += doc_freq.second * inverse_document_freq;
+                  query.plus_terms_.begin(), 
+                  query.plus_terms_.end(), 
+                  [&policy, &document_to_relevance_cm, &accept_document, budget, uses_impacts = query.uses_impacts_](const auto& term) {
+        const double inverse_document_freq = term.inverse_document_freq;
+        const PostingList& postings = *term.postings;
+        std::vector<std::size_t> blocks(postings.GetBlockCount());
+        std::iota(blocks.begin(), blocks.end(), 0);
+        std::for_each(policy, blocks.begin(), blocks.end(), [inverse_document_freq, uses_impacts, &postings, &document_to_relevance_cm, &accept_document, budget](const std::size_t block){
+            if (budget != nullptr && budget->CheckExpired()) {
+                return;
+            }
+            const PostingBlock postings_block = postings.GetBlock(block);
+            for (std::size_t i = 0; i < postings_block.size; ++i) {
+                const std::uint32_t document_index = postings_block.document_indices[i];
+                if (accept_document(document_index)) {
+                    // Unit multiples add up exactly, as the integer sums do
+                    document_to_relevance_cm[document_index].ref_to_value +=
+                        uses_impacts
+                            ? postings_block.impacts[i] * IMPACT_UNIT
+                            : postings_block.term_freqs[i] * inverse_document_freq;
+                }
             }
     });
 });
 	std::for_each(policy, 
-                  query.minus_words.begin(), 
-                  query.minus_words.end(), 
-                  [this, &policy, &document_to_relevance_cm](const std::string_view& word) {
-        if (word_to_document_freqs_.count(word) == 0) return;
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance_cm.Erase(document_id);
+                  query.minus_terms_.begin(), 
+                  query.minus_terms_.end(), 
+                  [&document_to_relevance_cm](const auto& term) {
+        for (const std::uint32_t document_index : term.postings->GetDocumentIndices()) {
+            document_to_relevance_cm.Erase(document_index);
         }
     });
 
-    auto document_to_relevance = document_to_relevance_cm.BuildOrdinaryMap();
-    std::vector<Document> matched_documents(document_to_relevance.size());
-    std::transform(policy, document_to_relevance.begin(), document_to_relevance.end(), matched_documents.begin(), [this](const auto& node) {
-        return Document{ node.first, node.second, documents_.at(node.first).rating };
+    std::pmr::vector<Document> matched_documents(GetQueryArena());
+    document_to_relevance_cm.ForEach([this, &matched_documents](const auto& node) {
+        matched_documents.push_back({ document_columns_.GetId(node.first), node.second, document_columns_.GetRating(node.first) });
     });
     return matched_documents;
-}
\ No newline at end of file
+}
+
+template <typename DocumentAcceptor>
+std::pmr::vector<Document> SearchServer::ScoreSparseDocuments(
+    const PreparedQuery &query, DocumentAcceptor &accept_document,
+    std::size_t posting_count, SearchBudget *budget) const {
+    std::pmr::memory_resource *arena = GetQueryArena();
+    struct Contribution {
+        std::uint32_t document_index;
+        // Keeps a document's terms in query order, so sums round as in
+        // dense scoring
+        std::uint32_t order;
+        // Impact units when scoring with impacts, added exactly
+        double value;
+    };
+    std::pmr::vector<Contribution> contributions(arena);
+    contributions.reserve(posting_count);
+    for (const auto &term : query.plus_terms_) {
+        const PostingList &postings = *term.postings;
+        for (std::size_t block = 0; block < postings.GetBlockCount(); ++block) {
+            if (budget != nullptr && budget->CheckExpired()) {
+                break;
+            }
+            const PostingBlock postings_block = postings.GetBlock(block);
+            for (std::size_t i = 0; i < postings_block.size; ++i) {
+                contributions.push_back(
+                    {postings_block.document_indices[i],
+                     static_cast<std::uint32_t>(contributions.size()),
+                     query.uses_impacts_
+                         ? static_cast<double>(postings_block.impacts[i])
+                         : postings_block.term_freqs[i] *
+                               term.inverse_document_freq});
+            }
+        }
+    }
+    std::sort(contributions.begin(), contributions.end(),
+              [](const Contribution &lhs, const Contribution &rhs) {
+                  return lhs.document_index != rhs.document_index
+                             ? lhs.document_index < rhs.document_index
+                             : lhs.order < rhs.order;
+              });
+
+    // Documents come in increasing index order, so every minus list is
+    // searched forward from the previous position
+    std::pmr::vector<std::size_t> minus_positions(query.minus_terms_.size(), 0,
+                                                  arena);
+    const auto is_excluded = [&query,
+                              &minus_positions](std::uint32_t document_index) {
+        for (std::size_t term = 0; term < query.minus_terms_.size(); ++term) {
+            const PostingList &postings = *query.minus_terms_[term].postings;
+            std::size_t &position = minus_positions[term];
+            position = postings.Seek(document_index, position);
+            if (position < postings.GetDocumentIndices().size() &&
+                postings.GetDocumentIndices()[position] == document_index) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::pmr::vector<Document> matched_documents(arena);
+    for (auto it = contributions.begin(); it != contributions.end();) {
+        const std::uint32_t document_index = it->document_index;
+        double relevance = 0.0;
+        for (; it != contributions.end() &&
+               it->document_index == document_index;
+             ++it) {
+            relevance += it->value;
+        }
+        if (is_excluded(document_index) || !accept_document(document_index)) {
+            continue;
+        }
+        matched_documents.push_back(
+            {document_columns_.GetId(document_index),
+             query.uses_impacts_ ? relevance * IMPACT_UNIT : relevance,
+             document_columns_.GetRating(document_index)});
+    }
+    return matched_documents;
+}
+
+template <typename DocumentAcceptor>
+std::pmr::vector<Document> SearchServer::ScoreRequiredDocuments(
+    const std::execution::sequenced_policy, const PreparedQuery &query,
+    DocumentAcceptor &accept_document, SearchBudget *budget) const {
+    std::pmr::vector<Document> matched_documents(GetQueryArena());
+    if (query.has_missing_required_term_) {
+        return matched_documents;
+    }
+    const auto required_terms = GetRequiredTerms(query);
+    const PostingList &rarest_postings = *required_terms.front()->postings;
+    for (std::size_t block = 0; block < rarest_postings.GetBlockCount();
+         ++block) {
+        if (budget != nullptr && budget->CheckExpired()) {
+            break;
+        }
+        ScoreRequiredBlock(query, required_terms, block, accept_document,
+                           matched_documents);
+    }
+    return matched_documents;
+}
+
+template <typename DocumentAcceptor>
+std::pmr::vector<Document> SearchServer::ScoreRequiredDocuments(
+    const std::execution::parallel_policy policy, const PreparedQuery &query,
+    DocumentAcceptor &accept_document, SearchBudget *budget) const {
+    std::pmr::vector<Document> matched_documents(GetQueryArena());
+    if (query.has_missing_required_term_) {
+        return matched_documents;
+    }
+    const auto required_terms = GetRequiredTerms(query);
+    const PostingList &rarest_postings = *required_terms.front()->postings;
+    // Worker threads have no query arena scope, so blocks collect into
+    // ordinary vectors
+    std::vector<std::vector<Document>> block_documents(
+        rarest_postings.GetBlockCount());
+    std::vector<std::size_t> blocks(block_documents.size());
+    std::iota(blocks.begin(), blocks.end(), 0);
+    std::for_each(policy, blocks.begin(), blocks.end(),
+                  [this, &query, &required_terms, &accept_document, budget,
+                   &block_documents](const std::size_t block) {
+                      if (budget != nullptr && budget->CheckExpired()) {
+                          return;
+                      }
+                      ScoreRequiredBlock(query, required_terms, block,
+                                         accept_document,
+                                         block_documents[block]);
+                  });
+    for (const auto &documents : block_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(),
+                                 documents.end());
+    }
+    return matched_documents;
+}
+
+template <typename DocumentAcceptor, typename Documents>
+void SearchServer::ScoreRequiredBlock(
+    const PreparedQuery &query,
+    const std::vector<const PreparedQuery::Term *> &required_terms,
+    std::size_t block, DocumentAcceptor &accept_document,
+    Documents &matched_documents) const {
+    const PostingBlock rarest_block =
+        required_terms.front()->postings->GetBlock(block);
+    std::uint32_t candidates[POSTING_BLOCK_SIZE];
+    std::size_t candidate_count = rarest_block.size;
+    std::copy(rarest_block.document_indices,
+              rarest_block.document_indices + candidate_count, candidates);
+
+    // Keeps the candidates whose presence in postings equals keep_present
+    const auto intersect = [&candidates, &candidate_count](
+                               const PostingList &postings, bool keep_present) {
+        const auto &document_indices = postings.GetDocumentIndices();
+        std::size_t position = 0;
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < candidate_count; ++i) {
+            position = postings.Seek(candidates[i], position);
+            const bool is_present = position < document_indices.size() &&
+                                    document_indices[position] == candidates[i];
+            if (is_present == keep_present) {
+                candidates[kept++] = candidates[i];
+            }
+        }
+        candidate_count = kept;
+    };
+    for (std::size_t term = 1; term < required_terms.size() && candidate_count > 0;
+         ++term) {
+        intersect(*required_terms[term]->postings, true);
+    }
+    for (const auto &term : query.minus_terms_) {
+        intersect(*term.postings, false);
+    }
+    candidate_count =
+        std::remove_if(candidates, candidates + candidate_count,
+                       [&accept_document](const std::uint32_t document_index) {
+                           return !accept_document(document_index);
+                       }) -
+        candidates;
+    if (candidate_count == 0) {
+        return;
+    }
+
+    // Terms are summed in query order, as in disjunctive scoring
+    double relevance[POSTING_BLOCK_SIZE] = {};
+    for (const auto &term : query.plus_terms_) {
+        const PostingList &postings = *term.postings;
+        const auto &document_indices = postings.GetDocumentIndices();
+        const auto &term_freqs = postings.GetTermFreqs();
+        const auto &impacts = postings.GetImpacts();
+        std::size_t position = 0;
+        for (std::size_t i = 0; i < candidate_count; ++i) {
+            position = postings.Seek(candidates[i], position);
+            if (position == document_indices.size()) {
+                break;
+            }
+            if (document_indices[position] == candidates[i]) {
+                relevance[i] +=
+                    query.uses_impacts_
+                        ? impacts[position] * IMPACT_UNIT
+                        : term_freqs[position] * term.inverse_document_freq;
+            }
+        }
+    }
+    for (std::size_t i = 0; i < candidate_count; ++i) {
+        matched_documents.push_back({document_columns_.GetId(candidates[i]),
+                                     relevance[i],
+                                     document_columns_.GetRating(candidates[i])});
+    }
+}
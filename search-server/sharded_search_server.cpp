@@ -0,0 +1,121 @@
+#include "sharded_search_server.h"
+
+#include <algorithm>
+#include <cstdint>
+
+ShardedSearchServer::ShardedSearchServer(const std::string &stop_words_text,
+                                         std::size_t shard_count)
+    : ShardedSearchServer(SplitIntoWordsView(stop_words_text), shard_count) {}
+
+void ShardedSearchServer::AddDocument(int document_id,
+                                      const std::string_view document,
+                                      DocumentStatus status,
+                                      const std::vector<int> &ratings) {
+    if (document_id < 0) {
+        throw std::invalid_argument("Invalid document_id"s);
+    }
+    shards_[GetShardIndex(document_id)].AddDocument(document_id, document,
+                                                    status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    if (document_id < 0) {
+        return;
+    }
+    shards_[GetShardIndex(document_id)].RemoveDocument(document_id);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+    const std::string_view raw_query, const DocumentFilter &filter) const {
+    const CorpusStats corpus_stats = GatherCorpusStats(raw_query);
+    std::vector<std::vector<Document>> shard_results(shards_.size());
+    std::transform(std::execution::par, shards_.begin(), shards_.end(),
+                   shard_results.begin(),
+                   [&raw_query, &corpus_stats, &filter](const SearchServer &shard) {
+                       return shard.FindTopDocuments(
+                           shard.Prepare(raw_query, corpus_stats), filter);
+                   });
+    return MergeTopDocuments(std::move(shard_results));
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+    const std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, DocumentFilter(status));
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+    const std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+SearchServer::DocumentContent ShardedSearchServer::MatchDocument(
+    const std::string_view raw_query, int document_id) const {
+    if (document_id < 0) {
+        throw std::out_of_range("Передан несуществующий document_id");
+    }
+    // Expanded terms must match the words the search used
+    const SearchServer &shard = shards_[GetShardIndex(document_id)];
+    return shard.MatchDocument(
+        shard.Prepare(raw_query, GatherCorpusStats(raw_query)), document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const SearchServer &shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+std::size_t ShardedSearchServer::GetShardCount() const { return shards_.size(); }
+
+const SearchServer &ShardedSearchServer::GetShard(std::size_t shard) const {
+    return shards_.at(shard);
+}
+
+std::size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    // Fibonacci hashing spreads sequential and strided ids evenly
+    const std::uint64_t hash =
+        static_cast<std::uint64_t>(document_id) * 0x9E3779B97F4A7C15ull;
+    return (hash >> 32) % shards_.size();
+}
+
+CorpusStats ShardedSearchServer::GatherCorpusStats(
+    const std::string_view raw_query) const {
+    CorpusStats corpus_stats;
+    for (const SearchServer &shard : shards_) {
+        corpus_stats += shard.GetCorpusStats(raw_query);
+    }
+    if (corpus_stats.word_expansions.empty()) {
+        return corpus_stats;
+    }
+    // Each shard expanded word* and word~N against its own vocabulary. The
+    // first words of the merged lists are those a single server would
+    // pick; every shard then counts the frequencies of the same words.
+    for (auto &[_, matches] : corpus_stats.word_expansions) {
+        if (matches.size() > MAX_WORD_EXPANSIONS) {
+            matches.resize(MAX_WORD_EXPANSIONS);
+        }
+    }
+    CorpusStats expanded_corpus_stats;
+    for (const SearchServer &shard : shards_) {
+        expanded_corpus_stats +=
+            shard.GetCorpusStats(raw_query, corpus_stats.word_expansions);
+    }
+    return expanded_corpus_stats;
+}
+
+std::vector<Document> ShardedSearchServer::MergeTopDocuments(
+    std::vector<std::vector<Document>> shard_results) {
+    std::vector<Document> matched_documents;
+    for (auto &documents : shard_results) {
+        matched_documents.insert(matched_documents.end(), documents.begin(),
+                                 documents.end());
+    }
+    std::sort(matched_documents.begin(), matched_documents.end(),
+              IsRankedHigher);
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return matched_documents;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <execution>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "corpus_stats.h"
+#include "document.h"
+#include "document_filter.h"
+#include "search_server.h"
+
+// Front for a corpus hash-partitioned by document id across in-process
+// SearchServer shards. Queries gather document frequencies and the
+// expansions of word* and word~N terms from every shard, so all shards
+// score the same words with corpus-wide IDF and the merged top documents
+// match those of a single unsharded server.
+class ShardedSearchServer {
+   public:
+    ShardedSearchServer(const std::string &stop_words_text,
+                        std::size_t shard_count);
+
+    template <typename StringContainer>
+    ShardedSearchServer(const StringContainer &stop_words,
+                        std::size_t shard_count);
+
+    void AddDocument(int document_id, const std::string_view document,
+                     DocumentStatus status, const std::vector<int> &ratings);
+
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+        const std::string_view raw_query,
+        DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query,
+                                           const DocumentFilter &filter) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query,
+                                           DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(
+        const std::string_view raw_query) const;
+
+    SearchServer::DocumentContent MatchDocument(
+        const std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+
+    std::size_t GetShardCount() const;
+
+    const SearchServer &GetShard(std::size_t shard) const;
+
+   private:
+    std::deque<SearchServer> shards_;
+
+    std::size_t GetShardIndex(int document_id) const;
+
+    // Also validates the query on the calling thread, so that shards
+    // searched in parallel do not throw
+    CorpusStats GatherCorpusStats(const std::string_view raw_query) const;
+
+    static std::vector<Document> MergeTopDocuments(
+        std::vector<std::vector<Document>> shard_results);
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(const StringContainer &stop_words,
+                                         std::size_t shard_count) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Shard count must be positive"s);
+    }
+    // Shards share one copy of the stop words and of the vocabulary
+    const auto shared_stop_words = MakeStopWordSet(stop_words);
+    const auto term_dictionary = std::make_shared<TermDictionary>();
+    for (std::size_t shard = 0; shard < shard_count; ++shard) {
+        shards_.emplace_back(shared_stop_words, term_dictionary);
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+    const std::string_view raw_query,
+    DocumentPredicate document_predicate) const {
+    const CorpusStats corpus_stats = GatherCorpusStats(raw_query);
+    std::vector<std::vector<Document>> shard_results(shards_.size());
+    std::transform(std::execution::par, shards_.begin(), shards_.end(),
+                   shard_results.begin(),
+                   [&raw_query, &corpus_stats,
+                    &document_predicate](const SearchServer &shard) {
+                       return shard.FindTopDocuments(
+                           shard.Prepare(raw_query, corpus_stats),
+                           document_predicate);
+                   });
+    return MergeTopDocuments(std::move(shard_results));
+}
@@ -1,5 +1,9 @@
 #include "string_processing.h"
 
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
 std::vector<std::string> SplitIntoWords(const std::string& text) {
     std::vector<std::string> words;
     std::string word;
@@ -20,8 +24,10 @@ std::vector<std::string> SplitIntoWords(const std::string& text) {
     return words;
 }
 
-std::vector<std::string_view> SplitIntoWordsView(const std::string_view text) {
-    std::vector<std::string_view> result;
+namespace {
+
+template <typename Container>
+void SplitIntoWordsViewTo(const std::string_view text, Container& result) {
     auto pos = text.find_first_not_of(" ");
     const auto pos_end = text.npos;
     while (pos != pos_end) {
@@ -29,5 +35,41 @@ std::vector<std::string_view> SplitIntoWordsView(const std::string_view text) {
         result.push_back(space == pos_end ? text.substr(pos) : text.substr(pos, space - pos));
         pos = text.find_first_not_of(" ", space);
     }
+}
+
+}  // namespace
+
+std::vector<std::string_view> SplitIntoWordsView(const std::string_view text) {
+    std::vector<std::string_view> result;
+    SplitIntoWordsViewTo(text, result);
     return result;
-} 
\ No newline at end of file
+}
+
+std::pmr::vector<std::string_view> SplitIntoWordsView(
+    const std::string_view text, std::pmr::memory_resource* resource) {
+    std::pmr::vector<std::string_view> result(resource);
+    SplitIntoWordsViewTo(text, result);
+    return result;
+} 
+std::string_view TakeWord(std::string_view& text) {
+    text = TrimLeft(text);
+    const auto end = std::min(text.find(' '), text.size());
+    const std::string_view word = text.substr(0, end);
+    text.remove_prefix(end);
+    return word;
+}
+
+std::string_view TrimLeft(std::string_view text) {
+    text.remove_prefix(std::min(text.find_first_not_of(' '), text.size()));
+    return text;
+}
+
+int ParseInt(const std::string_view text) {
+    int value = 0;
+    const auto [end, error] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc{} || end != text.data() + text.size()) {
+        throw std::invalid_argument("Invalid number " + std::string{text});
+    }
+    return value;
+}
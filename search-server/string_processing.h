@@ -1,11 +1,22 @@
 #pragma once
 
+#include <memory_resource>
 #include <string>
 #include <vector>
 #include <set>
 
 std::vector<std::string> SplitIntoWords(const std::string& text);
 std::vector<std::string_view> SplitIntoWordsView(const std::string_view text);
+std::pmr::vector<std::string_view> SplitIntoWordsView(
+    const std::string_view text, std::pmr::memory_resource* resource);
+
+// Removes the first space-separated word from text and returns it
+std::string_view TakeWord(std::string_view& text);
+
+std::string_view TrimLeft(std::string_view text);
+
+// The whole text must be a number, otherwise std::invalid_argument
+int ParseInt(const std::string_view text);
 
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& string_views) {
@@ -0,0 +1,48 @@
+#include "term_dictionary.h"
+
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+std::string_view TermDictionary::Acquire(std::string_view word) {
+    {
+        std::shared_lock lock(mutex_);
+        const auto it = terms_.find(word);
+        if (it != terms_.end()) {
+            it->second.fetch_add(1, std::memory_order_relaxed);
+            return it->first;
+        }
+    }
+    std::unique_lock lock(mutex_);
+    auto it = terms_.find(word);
+    if (it == terms_.end()) {
+        it = terms_.emplace(std::piecewise_construct, std::forward_as_tuple(word),
+                            std::forward_as_tuple(0))
+                 .first;
+    }
+    it->second.fetch_add(1, std::memory_order_relaxed);
+    return it->first;
+}
+
+void TermDictionary::Release(std::string_view term) {
+    std::unique_lock lock(mutex_);
+    const auto it = terms_.find(term);
+    if (it != terms_.end() &&
+        it->second.fetch_sub(1, std::memory_order_relaxed) == 1) {
+        terms_.erase(it);
+    }
+}
+
+std::size_t TermDictionary::GetTermCount() const {
+    std::shared_lock lock(mutex_);
+    return terms_.size();
+}
+
+MemoryUsage TermDictionary::GetMemoryUsage() const {
+    std::shared_lock lock(mutex_);
+    MemoryUsage usage{terms_.size(), 0, EstimateNodeBytes(terms_)};
+    for (const auto &[term, _] : terms_) {
+        usage.bytes += EstimateHeapBytes(term);
+    }
+    return usage;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+#include "memory_stats.h"
+#include "string_processing.h"
+
+// Interned words shared by any number of SearchServer instances. Each
+// server holds a reference to every word of its vocabulary and keys its
+// indexes by views of the interned copies, so a word used by many servers
+// is stored once. A word is freed when its last reference is released.
+// Thread-safe; servers are expected to share it through std::shared_ptr.
+class TermDictionary {
+   public:
+    TermDictionary() = default;
+
+    TermDictionary(const TermDictionary &) = delete;
+    TermDictionary &operator=(const TermDictionary &) = delete;
+
+    // Adds a reference to word and returns a view of the interned copy,
+    // valid until the reference is released
+    std::string_view Acquire(std::string_view word);
+
+    // term must be a view returned by Acquire
+    void Release(std::string_view term);
+
+    std::size_t GetTermCount() const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+   private:
+    mutable std::shared_mutex mutex_;
+    // Reference counts grow under a shared lock, erasing takes a unique one
+    std::map<std::string, std::atomic<std::size_t>, std::less<>> terms_;
+};
+
+// Stop words shared read-only by SearchServer instances
+using StopWordSet = std::set<std::string, std::less<>>;
+
+template <typename StringContainer>
+std::shared_ptr<const StopWordSet> MakeStopWordSet(
+    const StringContainer &stop_words) {
+    return std::make_shared<const StopWordSet>(
+        MakeUniqueNonEmptyStrings(stop_words));
+}
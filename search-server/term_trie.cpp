@@ -0,0 +1,301 @@
+#include "term_trie.h"
+
+#include <numeric>
+
+namespace {
+
+// Feeds UTF-8 bytes one at a time and reports completed code points
+class Utf8Decoder {
+   public:
+    // Returns true when byte completes a code point
+    bool Feed(unsigned char byte) {
+        if (remaining_ > 0 && (byte & 0xC0) == 0x80) {
+            code_point_ = (code_point_ << 6) | (byte & 0x3F);
+            return --remaining_ == 0;
+        }
+        if (byte >= 0xC0 && byte < 0xF8) {
+            remaining_ = byte >= 0xF0 ? 3 : byte >= 0xE0 ? 2 : 1;
+            code_point_ = byte & (0x3F >> remaining_);
+            return false;
+        }
+        remaining_ = 0;
+        code_point_ = byte;
+        return true;
+    }
+
+    std::uint32_t GetCodePoint() const { return code_point_; }
+
+   private:
+    std::uint32_t code_point_ = 0;
+    int remaining_ = 0;
+};
+
+// Row row_index + 1 of the Levenshtein automaton after reading code_point;
+// returns the row minimum. Only the band of cells within max_edits of the
+// diagonal can stay within max_edits, the rest are stored as max_edits + 1.
+int AdvanceRow(const std::vector<std::uint32_t> &word_code_points,
+               std::size_t row_index, const int *row, std::uint32_t code_point,
+               int max_edits, int *next_row) {
+    const int out_of_band = max_edits + 1;
+    const std::size_t size = word_code_points.size();
+    const std::size_t band = static_cast<std::size_t>(max_edits);
+    const std::size_t first = row_index + 1 > band ? row_index + 1 - band : 0;
+    const std::size_t last = std::min(size, row_index + 1 + band);
+    if (first > size) {
+        std::fill(next_row, next_row + size + 1, out_of_band);
+        return out_of_band;
+    }
+    std::fill(next_row, next_row + first, out_of_band);
+    int row_min = out_of_band;
+    for (std::size_t j = first; j <= last; ++j) {
+        int cell = row[j] + 1;
+        if (j > 0) {
+            cell = std::min(
+                {cell, (j > first ? next_row[j - 1] : out_of_band) + 1,
+                 row[j - 1] + (word_code_points[j - 1] == code_point ? 0 : 1)});
+        }
+        next_row[j] = std::min(cell, out_of_band);
+        row_min = std::min(row_min, next_row[j]);
+    }
+    std::fill(next_row + last + 1, next_row + size + 1, out_of_band);
+    return row_min;
+}
+
+}  // namespace
+
+std::vector<std::uint32_t> DecodeUtf8(std::string_view text) {
+    std::vector<std::uint32_t> code_points;
+    Utf8Decoder decoder;
+    for (const char c : text) {
+        if (decoder.Feed(static_cast<unsigned char>(c))) {
+            code_points.push_back(decoder.GetCodePoint());
+        }
+    }
+    return code_points;
+}
+
+int ComputeEditDistance(const std::vector<std::uint32_t> &word_code_points,
+                        std::string_view text, int max_edits) {
+    const std::size_t row_size = word_code_points.size() + 1;
+    std::vector<int> row(row_size);
+    std::vector<int> next_row(row_size);
+    std::iota(row.begin(), row.end(), 0);
+    Utf8Decoder decoder;
+    std::size_t row_index = 0;
+    for (const char c : text) {
+        if (!decoder.Feed(static_cast<unsigned char>(c))) {
+            continue;
+        }
+        if (AdvanceRow(word_code_points, row_index++, row.data(),
+                       decoder.GetCodePoint(), max_edits,
+                       next_row.data()) > max_edits) {
+            return max_edits + 1;
+        }
+        row.swap(next_row);
+    }
+    return std::min(row.back(), max_edits + 1);
+}
+
+TermTrie::TermTrie(const std::vector<std::string_view> &sorted_words) {
+    // Word range and depth of every node, needed only while building
+    struct NodeWords {
+        std::uint32_t begin;
+        std::uint32_t end;
+        std::uint32_t depth;
+    };
+    std::vector<NodeWords> node_words{
+        {0, static_cast<std::uint32_t>(sorted_words.size()), 0}};
+    labels_.push_back('\0');
+    is_word_.push_back(false);
+
+    // Nodes are expanded in creation order, which is breadth first
+    for (std::size_t node = 0; node < node_words.size(); ++node) {
+        auto [begin, end, depth] = node_words[node];
+        first_child_.push_back(static_cast<std::uint32_t>(node_words.size()));
+        // Words are sorted, so only the first one can end here
+        if (begin < end && sorted_words[begin].size() == depth) {
+            is_word_[node] = true;
+            ++begin;
+        }
+        while (begin < end) {
+            const char label = sorted_words[begin][depth];
+            std::uint32_t group_end = begin + 1;
+            while (group_end < end && sorted_words[group_end][depth] == label) {
+                ++group_end;
+            }
+            node_words.push_back({begin, group_end, depth + 1});
+            labels_.push_back(label);
+            is_word_.push_back(false);
+            begin = group_end;
+        }
+    }
+    first_child_.push_back(static_cast<std::uint32_t>(node_words.size()));
+}
+
+std::uint32_t TermTrie::FindChild(std::uint32_t node, char label) const {
+    const auto begin = labels_.begin() + first_child_[node];
+    const auto end = labels_.begin() + first_child_[node + 1];
+    const auto it = std::lower_bound(
+        begin, end, label, [](char lhs, char rhs) {
+            return static_cast<unsigned char>(lhs) < static_cast<unsigned char>(rhs);
+        });
+    return it != end && *it == label
+               ? static_cast<std::uint32_t>(it - labels_.begin())
+               : 0;
+}
+
+std::vector<std::string> TermTrie::ExpandPrefix(
+    std::string_view prefix, std::size_t max_words,
+    const std::function<bool(std::string_view)> &is_live) const {
+    std::vector<std::string> words;
+    std::uint32_t start = 0;
+    for (const char c : prefix) {
+        start = FindChild(start, c);
+        if (start == 0) {
+            return words;
+        }
+    }
+
+    // Depth-first in label order yields words in lexicographic order.
+    // Entries are a node and the path length of its parent.
+    std::string path(prefix);
+    std::vector<std::pair<std::uint32_t, std::size_t>> stack;
+    const auto push_children = [this, &stack, &path](std::uint32_t node) {
+        for (std::uint32_t child = first_child_[node + 1];
+             child-- > first_child_[node];) {
+            stack.emplace_back(child, path.size());
+        }
+    };
+    if (is_word_[start] && is_live(path)) {
+        words.push_back(path);
+    }
+    push_children(start);
+    while (!stack.empty() && words.size() < max_words) {
+        const auto [node, parent_length] = stack.back();
+        stack.pop_back();
+        path.resize(parent_length);
+        path += labels_[node];
+        if (is_word_[node] && is_live(path)) {
+            words.push_back(path);
+        }
+        push_children(node);
+    }
+    if (words.size() > max_words) {
+        words.resize(max_words);
+    }
+    return words;
+}
+
+std::vector<WordMatch> TermTrie::ExpandFuzzy(
+    std::string_view word, int max_edits, std::size_t max_words,
+    const std::function<bool(std::string_view)> &is_live) const {
+    const std::vector<std::uint32_t> word_code_points = DecodeUtf8(word);
+    const std::size_t row_size = word_code_points.size() + 1;
+    // rows[k] is the automaton row after k code points of the current path
+    std::vector<int> rows(row_size);
+    std::iota(rows.begin(), rows.end(), 0);
+
+    struct Entry {
+        std::uint32_t node;
+        std::size_t parent_length;
+        std::size_t code_point_count;
+        Utf8Decoder decoder;
+    };
+    std::vector<Entry> stack;
+    std::string path;
+    const auto push_children = [this, &stack, &path](const Entry &entry) {
+        for (std::uint32_t child = first_child_[entry.node + 1];
+             child-- > first_child_[entry.node];) {
+            stack.push_back({child, path.size(), entry.code_point_count,
+                             entry.decoder});
+        }
+    };
+
+    // Matches by distance; once max_words are no farther than some
+    // distance, farther branches are cut
+    std::vector<std::vector<std::string>> matches(max_edits + 1);
+    int limit = max_edits;
+    const auto count_within = [&matches](int distance) {
+        std::size_t count = 0;
+        for (int d = 0; d <= distance; ++d) {
+            count += matches[d].size();
+        }
+        return count;
+    };
+
+    if (row_size - 1 <= static_cast<std::size_t>(max_edits) && is_word_[0] &&
+        is_live({})) {
+        matches[row_size - 1].push_back({});
+    }
+    push_children({0, 0, 0, {}});
+    while (!stack.empty()) {
+        Entry entry = stack.back();
+        stack.pop_back();
+        path.resize(entry.parent_length);
+        path += labels_[entry.node];
+        if (!entry.decoder.Feed(static_cast<unsigned char>(labels_[entry.node]))) {
+            // Inside a multi-byte code point
+            push_children(entry);
+            continue;
+        }
+        const std::size_t row = entry.code_point_count;
+        if (rows.size() < (row + 2) * row_size) {
+            rows.resize((row + 2) * row_size);
+        }
+        const int row_min =
+            AdvanceRow(word_code_points, row, &rows[row * row_size],
+                       entry.decoder.GetCodePoint(), limit,
+                       &rows[(row + 1) * row_size]);
+        if (row_min > limit) {
+            continue;
+        }
+        ++entry.code_point_count;
+        const int distance = rows[(row + 1) * row_size + row_size - 1];
+        if (is_word_[entry.node] && distance <= limit &&
+            count_within(distance) < max_words && is_live(path)) {
+            matches[distance].push_back(path);
+            while (limit > 0 && count_within(limit - 1) >= max_words) {
+                --limit;
+            }
+        }
+        push_children(entry);
+    }
+
+    std::vector<WordMatch> result;
+    for (int distance = 0; distance <= max_edits; ++distance) {
+        for (std::string &match : matches[distance]) {
+            if (result.size() == max_words) {
+                return result;
+            }
+            result.push_back({std::move(match), distance});
+        }
+    }
+    return result;
+}
+
+std::size_t TermTrie::GetNodeCount() const { return labels_.size(); }
+
+std::size_t TermTrie::GetMemoryBytes() const {
+    return first_child_.capacity() * sizeof(std::uint32_t) + labels_.capacity() +
+           is_word_.capacity() / 8;
+}
+
+void TermTrieCache::AddWord(std::string_view word) {
+    std::lock_guard lock(mutex_);
+    if (!trie_) {
+        // The next build reads the word from the vocabulary
+        return;
+    }
+    if (pending_words_.size() == PENDING_WORD_LIMIT) {
+        trie_.reset();
+        pending_words_.clear();
+        return;
+    }
+    pending_words_.emplace_back(word);
+}
+
+void TermTrieCache::Invalidate() {
+    std::lock_guard lock(mutex_);
+    trie_.reset();
+    pending_words_.clear();
+}
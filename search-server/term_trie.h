@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct WordMatch {
+    std::string word;
+    int distance;
+};
+
+// Levenshtein distance between the code points of word and a UTF-8 text,
+// or max_edits + 1 when it exceeds max_edits
+int ComputeEditDistance(const std::vector<std::uint32_t> &word_code_points,
+                        std::string_view text, int max_edits);
+
+// Code points of a UTF-8 text; a stray continuation byte counts as a code
+// point of its own and a truncated sequence is dropped
+std::vector<std::uint32_t> DecodeUtf8(std::string_view text);
+
+// Immutable byte trie over a sorted list of distinct words. Nodes are laid
+// out breadth first, so the children of a node are contiguous and sorted
+// by label, and a node costs an index, a label byte and a bit.
+class TermTrie {
+   public:
+    explicit TermTrie(const std::vector<std::string_view> &sorted_words);
+
+    // Words starting with prefix, the first max_words in lexicographic
+    // order. Words that fail is_live are skipped before they count.
+    std::vector<std::string> ExpandPrefix(
+        std::string_view prefix, std::size_t max_words,
+        const std::function<bool(std::string_view)> &is_live) const;
+
+    // Words within max_edits edits of word, counting code points. Walks the
+    // trie with the rows of a Levenshtein automaton and cuts every branch
+    // whose row exceeds the limit. The max_words closest live ones, ties in
+    // lexicographic order.
+    std::vector<WordMatch> ExpandFuzzy(
+        std::string_view word, int max_edits, std::size_t max_words,
+        const std::function<bool(std::string_view)> &is_live) const;
+
+    std::size_t GetNodeCount() const;
+
+    std::size_t GetMemoryBytes() const;
+
+   private:
+    // Children of node i are [first_child_[i], first_child_[i + 1])
+    std::vector<std::uint32_t> first_child_;
+    std::vector<char> labels_;
+    std::vector<bool> is_word_;
+
+    // Child of node labeled label, or 0 (the root is nobody's child)
+    std::uint32_t FindChild(std::uint32_t node, char label) const;
+};
+
+// TermTrie over a growing vocabulary. Words added after the trie was built
+// wait in a short pending list that expansions scan directly; the trie is
+// rebuilt from the vocabulary on the first expansion after the list
+// overflows or after Invalidate. Expansions may run concurrently with each
+// other but not with AddWord and Invalidate. Copies start without a trie,
+// moves take it along.
+class TermTrieCache {
+   public:
+    TermTrieCache() = default;
+
+    TermTrieCache(const TermTrieCache &) {}
+
+    TermTrieCache(TermTrieCache &&other) noexcept
+        : trie_(std::move(other.trie_)),
+          pending_words_(std::move(other.pending_words_)) {}
+
+    TermTrieCache &operator=(const TermTrieCache &) = delete;
+
+    void AddWord(std::string_view word);
+
+    // Words were removed from the vocabulary
+    void Invalidate();
+
+    // vocabulary: sorted map keyed by the words. The vocabulary may keep
+    // words without documents until they are compacted away; is_live tells
+    // them apart, and only live words count toward max_words.
+    template <typename Vocabulary, typename WordPredicate>
+    std::vector<std::string> ExpandPrefix(const Vocabulary &vocabulary,
+                                          std::string_view prefix,
+                                          std::size_t max_words,
+                                          WordPredicate is_live) const;
+
+    // Closest words first, as TermTrie::ExpandFuzzy
+    template <typename Vocabulary, typename WordPredicate>
+    std::vector<WordMatch> ExpandFuzzy(const Vocabulary &vocabulary,
+                                       std::string_view word, int max_edits,
+                                       std::size_t max_words,
+                                       WordPredicate is_live) const;
+
+   private:
+    static constexpr std::size_t PENDING_WORD_LIMIT = 4096;
+
+    mutable std::mutex mutex_;
+    mutable std::shared_ptr<const TermTrie> trie_;
+    mutable std::vector<std::string> pending_words_;
+
+    // Must be called with mutex_ held
+    template <typename Vocabulary>
+    std::shared_ptr<const TermTrie> GetTrie(const Vocabulary &vocabulary) const;
+};
+
+template <typename Vocabulary>
+std::shared_ptr<const TermTrie> TermTrieCache::GetTrie(
+    const Vocabulary &vocabulary) const {
+    if (!trie_) {
+        std::vector<std::string_view> words;
+        words.reserve(vocabulary.size());
+        for (const auto &[word, _] : vocabulary) {
+            words.push_back(word);
+        }
+        trie_ = std::make_shared<const TermTrie>(words);
+        pending_words_.clear();
+    }
+    return trie_;
+}
+
+template <typename Vocabulary, typename WordPredicate>
+std::vector<std::string> TermTrieCache::ExpandPrefix(
+    const Vocabulary &vocabulary, std::string_view prefix,
+    std::size_t max_words, WordPredicate is_live) const {
+    std::shared_ptr<const TermTrie> trie;
+    std::vector<std::string> words;
+    {
+        std::lock_guard lock(mutex_);
+        trie = GetTrie(vocabulary);
+        for (const std::string &word : pending_words_) {
+            if (word.compare(0, prefix.size(), prefix) == 0 && is_live(word)) {
+                words.push_back(word);
+            }
+        }
+    }
+    // The first max_words live words of the union are among the first
+    // max_words of the trie and the pending words, so the cap applies to
+    // the merged list
+    std::vector<std::string> trie_words =
+        trie->ExpandPrefix(prefix, max_words, is_live);
+    words.insert(words.end(), std::make_move_iterator(trie_words.begin()),
+                 std::make_move_iterator(trie_words.end()));
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    if (words.size() > max_words) {
+        words.resize(max_words);
+    }
+    return words;
+}
+
+template <typename Vocabulary, typename WordPredicate>
+std::vector<WordMatch> TermTrieCache::ExpandFuzzy(
+    const Vocabulary &vocabulary, std::string_view word, int max_edits,
+    std::size_t max_words, WordPredicate is_live) const {
+    std::shared_ptr<const TermTrie> trie;
+    std::vector<WordMatch> matches;
+    {
+        std::lock_guard lock(mutex_);
+        trie = GetTrie(vocabulary);
+        const std::vector<std::uint32_t> word_code_points = DecodeUtf8(word);
+        for (const std::string &pending_word : pending_words_) {
+            const int distance =
+                ComputeEditDistance(word_code_points, pending_word, max_edits);
+            if (distance <= max_edits && is_live(pending_word)) {
+                matches.push_back({pending_word, distance});
+            }
+        }
+    }
+    std::vector<WordMatch> trie_matches =
+        trie->ExpandFuzzy(word, max_edits, max_words, is_live);
+    matches.insert(matches.end(), std::make_move_iterator(trie_matches.begin()),
+                   std::make_move_iterator(trie_matches.end()));
+    std::sort(matches.begin(), matches.end(),
+              [](const WordMatch &lhs, const WordMatch &rhs) {
+                  return lhs.distance != rhs.distance
+                             ? lhs.distance < rhs.distance
+                             : lhs.word < rhs.word;
+              });
+    // A word is pending or in the trie, never both
+    if (matches.size() > max_words) {
+        matches.resize(max_words);
+    }
+    return matches;
+}
@@ -1,16 +1,1152 @@
-#include <string>
-#include <vector>
-#include <set>
+#include "test_example_functions.h"
 
-std::vector<std::string> SplitIntoWords(const std::string& text);
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
 
-template <typename StringContainer>
-std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-    std::set<std::string> non_empty_strings;
-    for(const std::string& str : strings) {
-        if (!str.empty()) {
-            non_empty_strings.insert(str);
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "corpus_loader.h"
+#include "query_log.h"
+#include "query_server.h"
+
+void AddDocument(SearchServer &search_server, int document_id, const std::string &document, DocumentStatus status,
+                 const std::vector<int> &ratings) {
+    try {
+        search_server.AddDocument(document_id, document, status, ratings);
+    } catch (const std::exception &e) {
+        std::cout << "Ошибка добавления документа "s << document_id << ": "s << e.what() << std::endl;
+    }
+}
+
+void FindTopDocuments(const SearchServer &search_server, const std::string &raw_query) {
+    std::cout << "Результаты поиска по запросу: "s << raw_query << std::endl;
+    try {
+        for (const Document &document : search_server.FindTopDocuments(raw_query)) {
+            PrintDocument(document);
+        }
+    } catch (const std::exception &e) {
+        std::cout << "Ошибка поиска: "s << e.what() << std::endl;
+    }
+}
+
+void AssertImpl(bool value, const std::string &expr_str, const std::string &file, const std::string &func,
+                unsigned line, const std::string &hint) {
+    if (!value) {
+        std::cerr << file << "("s << line << "): "s << func << ": "s;
+        std::cerr << "ASSERT("s << expr_str << ") failed."s;
+        if (!hint.empty()) {
+            std::cerr << " Hint: "s << hint;
+        }
+        std::cerr << std::endl;
+        std::abort();
+    }
+}
+
+namespace {
+
+// Deterministic documents over a skewed vocabulary of words w0, w1, ...:
+// low numbers are common, high ones rare
+std::string MakeTestDocument(std::uint32_t &seed, int word_count) {
+    std::string document;
+    for (int i = 0; i < word_count; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        const std::uint32_t r = (seed >> 8) % 1000;
+        document += (i > 0 ? " w"s : "w"s) + std::to_string(r * r / 2000);
+    }
+    return document;
+}
+
+// Ratings are the ids, so rankings have no ties
+template <typename Server>
+void AddTestDocuments(Server &search_server, int first_id, int document_count) {
+    std::uint32_t seed = static_cast<std::uint32_t>(first_id) + 1;
+    for (int id = first_id; id < first_id + document_count; ++id) {
+        const auto status = static_cast<DocumentStatus>(id % 7 == 0 ? id % 4 : 0);
+        search_server.AddDocument(id, MakeTestDocument(seed, 6 + id % 10), status, {id});
+    }
+}
+
+const std::vector<std::string> TEST_QUERIES = {
+    "w0"s, "w1 w7"s, "w30 w120 w260"s, "w2 w3 -w5"s, "w400 w401 w402 w403"s, "w10 w11 w12 -w0"s, "w480"s, "w9 w99"s,
+};
+
+void AssertSameDocuments(const std::vector<Document> &lhs, const std::vector<Document> &rhs,
+                         const std::string &hint) {
+    ASSERT_EQUAL_HINT(lhs.size(), rhs.size(), hint);
+    for (std::size_t i = 0; i < lhs.size(); ++i) {
+        ASSERT_EQUAL_HINT(lhs[i].id, rhs[i].id, hint);
+        ASSERT_HINT(std::abs(lhs[i].relevance - rhs[i].relevance) < EPS, hint);
+        ASSERT_EQUAL_HINT(lhs[i].rating, rhs[i].rating, hint);
+    }
+}
+
+void TestScoringKernelsRankIdentically() {
+    // Tails shorter than a vector, and indices out of order
+    for (const ScoringIsa isa : {ScoringIsa::AVX2, ScoringIsa::AVX512}) {
+        if (!IsScoringIsaSupported(isa)) {
+            continue;
+        }
+        const AccumulateKernel kernel = GetAccumulateKernel(isa);
+        for (std::size_t count = 0; count <= 19; ++count) {
+            std::vector<std::uint32_t> document_indices(count);
+            std::vector<double> term_freqs(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                document_indices[i] = static_cast<std::uint32_t>((i * 7) % 23 * 3);
+                term_freqs[i] = 1.0 / static_cast<double>(i + 3);
+            }
+            std::vector<double> expected(70, 0.25);
+            std::vector<double> relevance = expected;
+            GetAccumulateKernel(ScoringIsa::SCALAR)(document_indices.data(), term_freqs.data(),
+                                                    count, 0.7, expected.data());
+            kernel(document_indices.data(), term_freqs.data(), count, 0.7, relevance.data());
+            ASSERT_HINT(relevance == expected, "isa "s + std::to_string(static_cast<int>(isa)) +
+                                                   ", count "s + std::to_string(count));
+        }
+    }
+
+    SearchServer search_server(""s);
+    AddTestDocuments(search_server, 0, 3000);
+    search_server.SetScoringIsa(ScoringIsa::SCALAR);
+    std::vector<std::vector<Document>> expected;
+    for (const std::string &query : TEST_QUERIES) {
+        expected.push_back(search_server.FindTopDocuments(query));
+        ASSERT_HINT(!expected.back().empty(), query);
+    }
+    for (const ScoringIsa isa : {ScoringIsa::SCALAR, ScoringIsa::AVX2,
+                                 ScoringIsa::AVX512}) {
+        if (!IsScoringIsaSupported(isa)) {
+            continue;
+        }
+        search_server.SetScoringIsa(isa);
+        ASSERT(search_server.GetScoringIsa() == isa);
+        for (std::size_t i = 0; i < TEST_QUERIES.size(); ++i) {
+            AssertSameDocuments(search_server.FindTopDocuments(TEST_QUERIES[i]), expected[i],
+                                "isa "s + std::to_string(static_cast<int>(isa)) + ": "s + TEST_QUERIES[i]);
+        }
+    }
+}
+
+// Queries of rare words only are scored sparsely by the sequential path,
+// the parallel path is always dense
+void TestSparseScoringMatchesDense() {
+    SearchServer search_server(""s);
+    AddTestDocuments(search_server, 0, 3000);
+    for (int id = 3000; id < 3030; ++id) {
+        search_server.AddDocument(id, "rare"s + std::to_string(id % 10) + " w1 w"s + std::to_string(id % 40),
+                                  DocumentStatus::ACTUAL, {id});
+    }
+    const std::vector<std::string> queries = {
+        "rare1"s, "rare2 rare3"s, "rare4 rare5 -w1"s, "rare6 -w9"s, "rare7 w480"s, "w2 w3 -w5"s,
+    };
+    for (const std::string &query : queries) {
+        AssertSameDocuments(search_server.FindTopDocuments(query),
+                            search_server.FindTopDocuments(std::execution::par, query), query);
+    }
+    search_server.EnableImpactScoring();
+    for (const std::string &query : queries) {
+        AssertSameDocuments(search_server.FindTopDocuments(query),
+                            search_server.FindTopDocuments(std::execution::par, query), "impacts: "s + query);
+    }
+    ASSERT(search_server.FindTopDocuments("rare4 rare5 -w1"s).empty());
+    ASSERT_EQUAL(search_server.FindTopDocuments("rare1"s).size(), 3u);
+}
+
+// Documents are removed faster than added while Compact runs a few words
+// per round, so tombstones are purged and internal indices renumbered in
+// the middle of the churn. Results must match a server holding only the
+// surviving documents. Under balanced churn after that, tombstones, dead
+// indices and memory must stay within the peaks of the first cycle.
+void TestCompactionUnderChurn() {
+    SearchServer search_server(""s);
+    search_server.EnableImpactScoring(0.05);
+    std::map<int, std::pair<std::string, DocumentStatus>> documents;
+    std::uint32_t seed = 17;
+    int next_id = 0;
+    const auto add_documents = [&](int count) {
+        for (int i = 0; i < count; ++i, ++next_id) {
+            const auto status = static_cast<DocumentStatus>(next_id % 7 == 0 ? next_id % 4 : 0);
+            std::string text = MakeTestDocument(seed, 6 + next_id % 10);
+            search_server.AddDocument(next_id, text, status, {next_id});
+            documents[next_id] = {std::move(text), status};
+        }
+    };
+    const auto check_results = [&](const std::string &hint) {
+        SearchServer expected_server(""s);
+        for (const auto &[id, document] : documents) {
+            expected_server.AddDocument(id, document.first, document.second, {id});
+        }
+        ASSERT_EQUAL_HINT(search_server.GetDocumentCount(), expected_server.GetDocumentCount(), hint);
+        search_server.RefreshImpacts();
+        for (const std::string &query : TEST_QUERIES) {
+            const std::vector<Document> expected = expected_server.FindTopDocuments(query);
+            AssertSameDocuments(search_server.FindTopDocuments(query), expected, hint + ": "s + query);
+            AssertSameDocuments(search_server.FindTopDocuments(std::execution::par, query), expected,
+                                hint + " par: "s + query);
+        }
+    };
+
+    add_documents(2000);
+    std::size_t max_dead_indices = 0;
+    bool has_renumbered = false;
+    for (int round = 0; round < 60; ++round) {
+        for (int i = 0; i < 70 && !documents.empty(); ++i) {
+            seed = seed * 1103515245u + 12345u;
+            auto it = documents.lower_bound(static_cast<int>((seed >> 8) % next_id));
+            if (it == documents.end()) {
+                it = documents.begin();
+            }
+            if (i % 2 == 0) {
+                search_server.RemoveDocument(it->first);
+            } else {
+                search_server.RemoveDocument(std::execution::par, it->first);
+            }
+            documents.erase(it);
+        }
+        add_documents(30);
+        search_server.Compact(64);
+
+        const IndexMemoryStats stats = search_server.GetMemoryStats();
+        has_renumbered |= stats.dead_document_indices < max_dead_indices;
+        max_dead_indices = std::max(max_dead_indices, stats.dead_document_indices);
+        if (round % 4 == 0) {
+            check_results("round "s + std::to_string(round));
+        }
+    }
+    ASSERT(has_renumbered);
+
+    search_server.Compact();
+    check_results("compacted"s);
+    const IndexMemoryStats stats = search_server.GetMemoryStats();
+    ASSERT_EQUAL(stats.dead_document_indices, 0u);
+    ASSERT_EQUAL(stats.empty_posting_lists, 0u);
+    ASSERT_EQUAL(stats.posting_tombstones, 0u);
+
+    // Then removals and additions balance: after the first renumbering the
+    // index must cycle between the same bounds instead of growing
+    struct CyclePeaks {
+        std::size_t posting_tombstones = 0;
+        std::size_t dead_document_indices = 0;
+        std::size_t bytes = 0;
+    };
+    std::vector<CyclePeaks> cycles(1);
+    add_documents(2000 - static_cast<int>(documents.size()));
+    std::size_t last_dead_indices = 0;
+    for (int round = 0; round < 300; ++round) {
+        for (int i = 0; i < 40; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            auto it = documents.lower_bound(static_cast<int>((seed >> 8) % next_id));
+            if (it == documents.end()) {
+                it = documents.begin();
+            }
+            search_server.RemoveDocument(it->first);
+            documents.erase(it);
+        }
+        add_documents(40);
+        search_server.Compact(64);
+
+        const IndexMemoryStats round_stats = search_server.GetMemoryStats();
+        if (round_stats.dead_document_indices < last_dead_indices) {
+            cycles.emplace_back();
+        }
+        last_dead_indices = round_stats.dead_document_indices;
+        CyclePeaks &peaks = cycles.back();
+        peaks.posting_tombstones = std::max(peaks.posting_tombstones, round_stats.posting_tombstones);
+        peaks.dead_document_indices = std::max(peaks.dead_document_indices, round_stats.dead_document_indices);
+        peaks.bytes = std::max(peaks.bytes, round_stats.total.bytes);
+    }
+    check_results("steady"s);
+    // The last cycle may be cut short. Peaks vary by a few percent with the
+    // words that churn.
+    ASSERT_HINT(cycles.size() >= 4, std::to_string(cycles.size()) + " cycles"s);
+    for (std::size_t cycle = 1; cycle + 1 < cycles.size(); ++cycle) {
+        const std::string hint = "cycle "s + std::to_string(cycle) + ": "s;
+        ASSERT_HINT(cycles[cycle].posting_tombstones * 4 <= cycles[0].posting_tombstones * 5,
+                    hint + std::to_string(cycles[cycle].posting_tombstones) + " tombstones"s);
+        ASSERT_HINT(cycles[cycle].dead_document_indices * 4 <= cycles[0].dead_document_indices * 5,
+                    hint + std::to_string(cycles[cycle].dead_document_indices) + " dead indices"s);
+        ASSERT_HINT(cycles[cycle].bytes * 4 <= cycles[0].bytes * 5,
+                    hint + std::to_string(cycles[cycle].bytes) + " bytes"s);
+    }
+}
+
+
+void TestPreCancelledSearch() {
+    SearchServer search_server(""s);
+    AddTestDocuments(search_server, 0, 3000);
+    const PreparedQuery query = search_server.Prepare("w0 w1"s);
+    CancellationToken token;
+    token.Cancel();
+    for (const bool is_parallel : {false, true}) {
+        SearchBudget budget(std::chrono::hours(1), token);
+        const SearchResult result =
+            is_parallel ? search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, budget)
+                        : search_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, budget);
+        ASSERT(result.is_partial);
+        ASSERT(result.documents.empty());
+        ASSERT(budget.IsExpired());
+    }
+
+    SearchBudget budget(std::chrono::hours(1));
+    const SearchResult result =
+        search_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, budget);
+    ASSERT(!result.is_partial);
+    AssertSameDocuments(result.documents, search_server.FindTopDocuments(query), "full budget"s);
+}
+
+// The first predicate call outlasts the deadline, so scoring stops at the
+// next posting block with the documents of the first one ranked
+void TestDeadlineExpiresMidQuery() {
+    SearchServer search_server(""s);
+    AddTestDocuments(search_server, 0, 3000);
+    const PreparedQuery query = search_server.Prepare("w0"s);
+
+    int full_calls = 0;
+    search_server.FindTopDocuments(std::execution::seq, query, [&full_calls](int, DocumentStatus, int) {
+        ++full_calls;
+        return true;
+    });
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+    SearchBudget budget(deadline);
+    int calls = 0;
+    const SearchResult result = search_server.FindTopDocuments(
+        std::execution::seq, query,
+        [&calls, deadline](int, DocumentStatus, int) {
+            if (calls++ == 0) {
+                std::this_thread::sleep_until(deadline);
+            }
+            return true;
+        },
+        budget);
+    ASSERT(result.is_partial);
+    ASSERT(!result.documents.empty());
+    ASSERT_HINT(calls > 0 && calls < full_calls, std::to_string(calls) + " of "s + std::to_string(full_calls));
+}
+
+// Cancels a search blocked in its predicate from the calling thread
+void TestAsyncSearchCancellation() {
+    SearchServer search_server(""s);
+    AddTestDocuments(search_server, 0, 3000);
+    CancellationToken token;
+    auto started = std::make_shared<std::promise<void>>();
+    auto is_started = std::make_shared<std::atomic<bool>>(false);
+    std::future<void> search_started = started->get_future();
+    std::future<SearchResult> search = search_server.FindTopDocumentsAsync(
+        "w0 w1"s,
+        [started, is_started, token](int, DocumentStatus, int) {
+            if (!is_started->exchange(true)) {
+                started->set_value();
+                while (!token.IsCancelled()) {
+                    std::this_thread::yield();
+                }
+            }
+            return true;
+        },
+        std::chrono::hours(1), token);
+    search_started.wait();
+    token.Cancel();
+    const SearchResult result = search.get();
+    ASSERT(result.is_partial);
+
+    const SearchResult full_result = search_server.FindTopDocumentsAsync("w0 w1"s, std::chrono::hours(1)).get();
+    ASSERT(!full_result.is_partial);
+    AssertSameDocuments(full_result.documents, search_server.FindTopDocuments("w0 w1"s), "async"s);
+}
+
+// * and ~ that do not form a prefix or fuzzy query are matched literally
+void TestQuerySyntaxFallsBackToLiteralWords() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "a~b cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "c** *"s, DocumentStatus::ACTUAL, {2});
+    search_server.AddDocument(3, "a cab"s, DocumentStatus::ACTUAL, {3});
+
+    const auto find_ids = [&search_server](const std::string &query) {
+        std::vector<int> ids;
+        for (const Document &document : search_server.FindTopDocuments(query)) {
+            ids.push_back(document.id);
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+    ASSERT_EQUAL(find_ids("a~b"s), std::vector<int>{1});
+    ASSERT_EQUAL(find_ids("c**"s), std::vector<int>{2});
+    ASSERT_EQUAL(find_ids("*"s), std::vector<int>{2});
+    ASSERT_EQUAL(find_ids("cat -a~b"s), std::vector<int>{});
+    ASSERT_EQUAL(find_ids("ca*"s), (std::vector<int>{1, 3}));
+    ASSERT_EQUAL(find_ids("cat~"s), (std::vector<int>{1, 3}));
+    ASSERT_EQUAL(find_ids("a~1"s), (std::vector<int>{2, 3}));
+    const auto [words, status] = search_server.MatchDocument("a~b"s, 1);
+    ASSERT_EQUAL(words.size(), 1u);
+    ASSERT_EQUAL(words.front(), "a~b"s);
+
+    bool is_rejected = false;
+    try {
+        search_server.FindTopDocuments("a~9"s);
+    } catch (const std::invalid_argument &) {
+        is_rejected = true;
+    }
+    ASSERT(is_rejected);
+}
+
+// Words left without documents must not use up the expansion limit
+void TestExpansionSkipsRemovedWords() {
+    static_assert(MAX_WORD_EXPANSIONS < 40);
+    SearchServer search_server(""s);
+    for (int id = 0; id < 40; ++id) {
+        search_server.AddDocument(id, "aa"s + std::to_string(100 + id), DocumentStatus::ACTUAL, {id});
+    }
+    ASSERT_EQUAL(search_server.FindTopDocuments("aa*"s).size(), static_cast<std::size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    for (int id = 0; id < 37; ++id) {
+        search_server.RemoveDocument(id);
+    }
+    // New words wait in the pending list of the already built trie
+    search_server.AddDocument(99, "aa199"s, DocumentStatus::ACTUAL, {99});
+
+    const auto find_ids = [&search_server](const std::string &query) {
+        std::vector<int> ids;
+        for (const Document &document : search_server.FindTopDocuments(query)) {
+            ids.push_back(document.id);
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+    const std::vector<int> expected = {37, 38, 39, 99};
+    ASSERT_EQUAL(find_ids("aa*"s), expected);
+    ASSERT_EQUAL(find_ids("aa100~2"s), expected);
+    ASSERT_EQUAL(find_ids("aa13*"s), (std::vector<int>{37, 38, 39}));
+    search_server.Compact();
+    ASSERT_EQUAL(find_ids("aa*"s), expected);
+    ASSERT_EQUAL(find_ids("aa100~2"s), expected);
+}
+
+// Shards expand word* and word~N against their own vocabularies, but must
+// pick the same words as a single server
+void TestShardedExpansionMatchesSingleServer() {
+    SearchServer search_server(""s);
+    ShardedSearchServer sharded_server(""s, 4);
+    for (int id = 0; id < 200; ++id) {
+        const std::string document = "pre"s + std::to_string(id) + (id % 3 == 0 ? " tail"s : " pre"s);
+        search_server.AddDocument(id, document, DocumentStatus::ACTUAL, {id});
+        sharded_server.AddDocument(id, document, DocumentStatus::ACTUAL, {id});
+    }
+    for (const std::string &query : {"pre*"s, "pre1*"s, "pre10~1"s, "pre10~2 -pre1*"s, "tail pre19*"s}) {
+        AssertSameDocuments(sharded_server.FindTopDocuments(query), search_server.FindTopDocuments(query), query);
+    }
+    for (const int id : {0, 10, 11, 100, 199}) {
+        const auto [words, _] = search_server.MatchDocument("pre1*"s, id);
+        const auto [sharded_words, __] = sharded_server.MatchDocument("pre1*"s, id);
+        ASSERT_EQUAL_HINT(sharded_words, words, std::to_string(id));
+    }
+}
+
+// Shards score with corpus-wide statistics, so the merged top documents
+// do not depend on the shard count
+void TestShardCountDoesNotChangeResults() {
+    ShardedSearchServer single_shard(""s, 1);
+    AddTestDocuments(single_shard, 0, 3000);
+    for (const std::size_t shard_count : {2u, 3u, 8u}) {
+        ShardedSearchServer sharded_server(""s, shard_count);
+        AddTestDocuments(sharded_server, 0, 3000);
+        ASSERT_EQUAL(sharded_server.GetDocumentCount(), single_shard.GetDocumentCount());
+        const std::string hint = std::to_string(shard_count) + " shards: "s;
+        for (const std::string &query : TEST_QUERIES) {
+            const std::vector<Document> expected = single_shard.FindTopDocuments(query);
+            ASSERT_HINT(!expected.empty(), query);
+            AssertSameDocuments(sharded_server.FindTopDocuments(query), expected, hint + query);
+            AssertSameDocuments(sharded_server.FindTopDocuments(query, DocumentStatus::BANNED),
+                                single_shard.FindTopDocuments(query, DocumentStatus::BANNED),
+                                hint + "banned "s + query);
+            const auto is_odd = [](int document_id, DocumentStatus, int) { return document_id % 2 == 1; };
+            AssertSameDocuments(sharded_server.FindTopDocuments(query, is_odd),
+                                single_shard.FindTopDocuments(query, is_odd), hint + "odd "s + query);
+        }
+    }
+}
+
+// Copies share the term dictionary; every server releases its own words
+void TestCopyAndMoveShareTermDictionary() {
+    static_assert(std::is_copy_constructible_v<SearchServer> && std::is_nothrow_move_constructible_v<SearchServer>);
+    const auto term_dictionary = std::make_shared<TermDictionary>();
+    {
+        SearchServer search_server(MakeStopWordSet(std::vector<std::string>{"and"s}), term_dictionary);
+        AddTestDocuments(search_server, 0, 500);
+        const std::size_t term_count = term_dictionary->GetTermCount();
+
+        SearchServer copy(search_server);
+        ASSERT_EQUAL(term_dictionary->GetTermCount(), term_count);
+        for (const std::string &query : TEST_QUERIES) {
+            AssertSameDocuments(copy.FindTopDocuments(query), search_server.FindTopDocuments(query), query);
+        }
+        const PreparedQuery query = search_server.Prepare("w0 w1"s);
+        AssertSameDocuments(copy.FindTopDocuments(query), search_server.FindTopDocuments(query), "prepared"s);
+
+        for (int id = 0; id < 250; ++id) {
+            copy.RemoveDocument(id);
+        }
+        copy.Compact();
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 500);
+        ASSERT_EQUAL(term_dictionary->GetTermCount(), term_count);
+
+        std::vector<SearchServer> servers;
+        servers.push_back(std::move(copy));
+        servers.push_back(std::move(search_server));
+        ASSERT_EQUAL(servers[0].GetDocumentCount(), 250);
+        ASSERT_EQUAL(servers[1].GetDocumentCount(), 500);
+        ASSERT(!servers[0].FindTopDocuments("w0"s).empty());
+        ASSERT(!servers[1].FindTopDocuments("w0 and"s).empty());
+        ASSERT_EQUAL(term_dictionary->GetTermCount(), term_count);
+    }
+    ASSERT_EQUAL(term_dictionary->GetTermCount(), 0u);
+}
+
+// Status overloads and DocumentFilter are compiled to bitmap and column
+// checks; they must select exactly what the equivalent predicate does
+void TestFiltersMatchEquivalentPredicates() {
+    SearchServer search_server(""s);
+    AddTestDocuments(search_server, 0, 3000);
+    for (int id = 0; id < 3000; id += 9) {
+        search_server.RemoveDocument(id);
+    }
+    DocumentFilter rated(DocumentStatus::ACTUAL);
+    rated.min_rating = 1000;
+    rated.max_rating = 2500;
+    DocumentFilter by_id;
+    by_id.min_document_id = 500;
+    by_id.max_document_id = 1999;
+    DocumentFilter several_statuses;
+    several_statuses.statuses = {DocumentStatus::IRRELEVANT, DocumentStatus::REMOVED};
+
+    const auto check = [&search_server, &rated, &by_id, &several_statuses](const auto &policy,
+                                                                           const std::string &policy_name) {
+        for (const std::string &query : TEST_QUERIES) {
+            const std::string hint = policy_name + ": "s + query;
+            AssertSameDocuments(search_server.FindTopDocuments(policy, query),
+                                search_server.FindTopDocuments(policy, query,
+                                                               [](int, DocumentStatus status, int) {
+                                                                   return status == DocumentStatus::ACTUAL;
+                                                               }),
+                                hint);
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT,
+                                                DocumentStatus::BANNED, DocumentStatus::REMOVED}) {
+                AssertSameDocuments(
+                    search_server.FindTopDocuments(policy, query, status),
+                    search_server.FindTopDocuments(policy, query,
+                                                   [status](int, DocumentStatus document_status, int) {
+                                                       return document_status == status;
+                                                   }),
+                    hint + " status "s + std::to_string(static_cast<int>(status)));
+            }
+            AssertSameDocuments(search_server.FindTopDocuments(policy, query, rated),
+                                search_server.FindTopDocuments(policy, query,
+                                                               [](int, DocumentStatus status, int rating) {
+                                                                   return status == DocumentStatus::ACTUAL &&
+                                                                          rating >= 1000 && rating <= 2500;
+                                                               }),
+                                hint + " rating"s);
+            AssertSameDocuments(search_server.FindTopDocuments(policy, query, by_id),
+                                search_server.FindTopDocuments(policy, query,
+                                                               [](int document_id, DocumentStatus, int) {
+                                                                   return document_id >= 500 && document_id <= 1999;
+                                                               }),
+                                hint + " id"s);
+            AssertSameDocuments(search_server.FindTopDocuments(policy, query, several_statuses),
+                                search_server.FindTopDocuments(policy, query,
+                                                               [](int, DocumentStatus status, int) {
+                                                                   return status == DocumentStatus::IRRELEVANT ||
+                                                                          status == DocumentStatus::REMOVED;
+                                                               }),
+                                hint + " statuses"s);
+        }
+    };
+    check(std::execution::seq, "seq"s);
+    check(std::execution::par, "par"s);
+    check(std::execution::par_unseq, "par_unseq"s);
+    for (const std::string &query : TEST_QUERIES) {
+        AssertSameDocuments(search_server.FindTopDocuments(query, DocumentStatus::BANNED),
+                            search_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::BANNED),
+                            query);
+    }
+}
+
+// A prepared query holds pointers into one server's index: it is reused
+// while that index is unchanged and re-prepared otherwise
+void TestPreparedQueryReuseAndInvalidation() {
+    const auto fill = [](SearchServer &search_server) {
+        AddTestDocuments(search_server, 0, 1000);
+    };
+    SearchServer search_server(""s);
+    fill(search_server);
+    const std::string raw_query = "w0 w1 -w5"s;
+    const PreparedQuery query = search_server.Prepare(raw_query);
+    ASSERT_EQUAL(query.GetGeneration(), search_server.GetGeneration());
+    const std::vector<Document> expected = search_server.FindTopDocuments(raw_query);
+    for (int i = 0; i < 3; ++i) {
+        AssertSameDocuments(search_server.FindTopDocuments(query), expected, "reused"s);
+        AssertSameDocuments(search_server.FindTopDocuments(std::execution::par, query), expected, "reused par"s);
+    }
+
+    const auto check_stale = [&search_server, &query, &raw_query](const std::string &hint) {
+        ASSERT_HINT(query.GetGeneration() != search_server.GetGeneration(), hint);
+        AssertSameDocuments(search_server.FindTopDocuments(query), search_server.FindTopDocuments(raw_query), hint);
+        AssertSameDocuments(search_server.FindTopDocuments(std::execution::par, query),
+                            search_server.FindTopDocuments(raw_query), hint + " par"s);
+    };
+    search_server.AddDocument(5000, "w0 w1 w1 w1"s, DocumentStatus::ACTUAL, {5000});
+    check_stale("added"s);
+    ASSERT_EQUAL(search_server.FindTopDocuments(query).front().id, 5000);
+    search_server.RemoveDocument(5000);
+    check_stale("removed"s);
+    const std::uint64_t generation = search_server.GetGeneration();
+    for (int id = 0; id < 1000; id += 3) {
+        search_server.RemoveDocument(id);
+    }
+    search_server.Compact();
+    ASSERT(search_server.GetGeneration() != generation);
+    check_stale("compacted"s);
+
+    // Prepared on another server with the same documents
+    SearchServer other_server(""s);
+    fill(other_server);
+    const PreparedQuery other_query = other_server.Prepare(raw_query);
+    ASSERT(other_query.GetGeneration() != search_server.GetGeneration());
+    AssertSameDocuments(search_server.FindTopDocuments(other_query), search_server.FindTopDocuments(raw_query),
+                        "other server"s);
+    const auto [words, status] = search_server.MatchDocument(other_query, 1);
+    const auto [expected_words, expected_status] = search_server.MatchDocument(raw_query, 1);
+    ASSERT_EQUAL(words, expected_words);
+
+    // A server rebuilt at the same address with the same changes must not
+    // take the old query for its own
+    std::optional<SearchServer> rebuilt_server(std::in_place, ""s);
+    fill(*rebuilt_server);
+    const PreparedQuery old_query = rebuilt_server->Prepare(raw_query);
+    const std::uint64_t old_generation = rebuilt_server->GetGeneration();
+    rebuilt_server.reset();
+    rebuilt_server.emplace(""s);
+    fill(*rebuilt_server);
+    ASSERT(rebuilt_server->GetGeneration() != old_generation);
+    AssertSameDocuments(rebuilt_server->FindTopDocuments(old_query), expected, "rebuilt"s);
+
+    // Copies and moves are separate indexes
+    SearchServer copy(other_server);
+    ASSERT(copy.GetGeneration() != other_server.GetGeneration());
+    AssertSameDocuments(copy.FindTopDocuments(other_query), expected, "copy"s);
+    const std::uint64_t moved_generation = other_server.GetGeneration();
+    SearchServer moved(std::move(copy));
+    ASSERT(moved.GetGeneration() != moved_generation);
+    AssertSameDocuments(moved.FindTopDocuments(other_query), expected, "moved"s);
+}
+
+
+// Seek gallops from a hint, it must land where a plain binary search would
+void TestPostingListSeek() {
+    PostingList postings;
+    for (std::uint32_t document_index = 0; document_index < 3000; document_index += 3) {
+        postings.Add(document_index, 1.0);
+    }
+    for (std::uint32_t document_index = 300; document_index < 900; document_index += 6) {
+        postings.Remove(document_index);
+    }
+    const auto &document_indices = postings.GetDocumentIndices();
+    for (const std::size_t from : {std::size_t{0}, std::size_t{1}, std::size_t{127}, std::size_t{128},
+                                   std::size_t{500}, document_indices.size()}) {
+        for (std::uint32_t document_index = 0; document_index < 3010; document_index += 7) {
+            const std::size_t expected =
+                std::max(from, static_cast<std::size_t>(std::lower_bound(document_indices.begin(),
+                                                                         document_indices.end(), document_index) -
+                                                        document_indices.begin()));
+            ASSERT_EQUAL_HINT(postings.Seek(document_index, from), expected,
+                              std::to_string(document_index) + " from "s + std::to_string(from));
+        }
+    }
+}
+
+// +word keeps only the documents that contain the word, which must rank
+// exactly as the same query without pluses restricted by a predicate
+void TestRequiredWordsMatchFilteredDisjunction() {
+    SearchServer search_server(""s);
+    AddTestDocuments(search_server, 0, 3000);
+    for (int id = 0; id < 3000; id += 11) {
+        search_server.RemoveDocument(id);
+    }
+    search_server.AddDocument(5000, "gone w0 w1"s, DocumentStatus::ACTUAL, {5000});
+    search_server.RemoveDocument(5000);
+
+    // Required words span several posting blocks, or fit in one
+    const auto count_documents = [&search_server](const std::string &word) {
+        std::size_t count = 0;
+        for (const int document_id : search_server) {
+            count += !std::get<0>(search_server.MatchDocument(word, document_id)).empty();
+        }
+        return count;
+    };
+    ASSERT(count_documents("w0"s) > 3 * POSTING_BLOCK_SIZE);
+    ASSERT(count_documents("w1"s) > 3 * POSTING_BLOCK_SIZE);
+    ASSERT(count_documents("w300"s) < POSTING_BLOCK_SIZE);
+    const std::vector<std::pair<std::string, std::vector<std::string>>> queries = {
+        {"+w0"s, {"w0"s}},
+        {"+w0 +w1 w7"s, {"w0"s, "w1"s}},
+        {"+w2 +w3 -w5"s, {"w2"s, "w3"s}},
+        {"+w1 w30 w120 -w0 -w4"s, {"w1"s}},
+        {"+w0 +w0 w0 w2"s, {"w0"s}},
+        {"+w0 +w300"s, {"w0"s, "w300"s}},
+        {"+w0 w1 +nosuchword"s, {"w0"s, "nosuchword"s}},
+        {"+gone w0"s, {"gone"s}},
+        {"+w1 -w1"s, {"w1"s}},
+    };
+    const auto check = [&search_server, &queries](auto policy, const std::string &policy_name) {
+        for (const auto &[query, required_words] : queries) {
+            std::string disjunctive_query = query;
+            disjunctive_query.erase(std::remove(disjunctive_query.begin(), disjunctive_query.end(), '+'),
+                                    disjunctive_query.end());
+            const auto contains_required_words = [&search_server, &required_words](int document_id,
+                                                                                     DocumentStatus status, int) {
+                for (const std::string &word : required_words) {
+                    if (std::get<0>(search_server.MatchDocument(word, document_id)).empty()) {
+                        return false;
+                    }
+                }
+                return status == DocumentStatus::ACTUAL;
+            };
+            const std::vector<Document> expected =
+                search_server.FindTopDocuments(disjunctive_query, contains_required_words);
+            const std::string hint = policy_name + ": "s + query;
+            AssertSameDocuments(search_server.FindTopDocuments(policy, query), expected, hint);
+            AssertSameDocuments(search_server.FindTopDocuments(policy, query, DocumentStatus::BANNED),
+                                search_server.FindTopDocuments(
+                                    disjunctive_query,
+                                    [&contains_required_words](int document_id, DocumentStatus status, int rating) {
+                                        return status == DocumentStatus::BANNED &&
+                                               contains_required_words(document_id, DocumentStatus::ACTUAL, rating);
+                                    }),
+                                hint + " banned"s);
+        }
+    };
+    check(std::execution::seq, "seq"s);
+    check(std::execution::par, "par"s);
+    search_server.EnableImpactScoring();
+    check(std::execution::seq, "seq impacts"s);
+    check(std::execution::par, "par impacts"s);
+
+    ASSERT(search_server.FindTopDocuments("+w0 +nosuchword"s).empty());
+    ASSERT(search_server.FindTopDocuments("+gone"s).empty());
+    ASSERT(search_server.FindTopDocuments("+w0~x w0"s).empty());
+    ASSERT(!search_server.FindTopDocuments("+w0 +w1"s).empty());
+
+    // Expansions cannot be required, and a sign needs a word after it
+    for (const std::string &query : {"+w0*"s, "+w0~"s, "+w0~1"s, "+"s, "++w0"s, "+-w0"s, "-+w0"s, "w1 +"s}) {
+        bool is_rejected = false;
+        try {
+            search_server.FindTopDocuments(query);
+        } catch (const std::invalid_argument &) {
+            is_rejected = true;
+        }
+        ASSERT_HINT(is_rejected, query);
+    }
+}
+
+
+// Index resource that notes any use from a thread other than its owner's
+class SingleThreadResource : public std::pmr::memory_resource {
+   public:
+    bool IsUsedElsewhere() const { return is_used_elsewhere_; }
+
+   private:
+    const std::thread::id owner_ = std::this_thread::get_id();
+    std::atomic<bool> is_used_elsewhere_{false};
+
+    void Check() {
+        if (std::this_thread::get_id() != owner_) {
+            is_used_elsewhere_ = true;
         }
     }
-    return non_empty_strings;
-}
\ No newline at end of file
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        Check();
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) override {
+        Check();
+        std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+};
+
+// The index resource need not be thread-safe, parallel removal must touch
+// it from the calling thread only
+void TestParallelRemoveKeepsResourceOnCallingThread() {
+    SingleThreadResource resource;
+    {
+        SearchServer search_server(""s, &resource);
+        SearchServer expected_server(""s);
+        AddTestDocuments(search_server, 0, 1000);
+        AddTestDocuments(expected_server, 0, 1000);
+        for (int id = 0; id < 1000; id += 3) {
+            search_server.RemoveDocument(std::execution::par, id);
+            expected_server.RemoveDocument(id);
+        }
+        ASSERT(!resource.IsUsedElsewhere());
+        ASSERT_EQUAL(search_server.GetDocumentCount(), expected_server.GetDocumentCount());
+        for (const std::string &query : TEST_QUERIES) {
+            AssertSameDocuments(search_server.FindTopDocuments(query), expected_server.FindTopDocuments(query),
+                                query);
+        }
+    }
+}
+
+// Path in the temporary directory, removed with the object
+class TemporaryFile {
+   public:
+    explicit TemporaryFile(const std::string &name)
+        : path_((std::filesystem::temp_directory_path() /
+                 ("search_server_"s + std::to_string(getpid()) + "_"s + name))
+                    .string()) {}
+
+    TemporaryFile(const TemporaryFile &) = delete;
+    TemporaryFile &operator=(const TemporaryFile &) = delete;
+
+    ~TemporaryFile() {
+        std::error_code error;
+        std::filesystem::remove(path_, error);
+    }
+
+    const std::string &GetPath() const { return path_; }
+
+   private:
+    std::string path_;
+};
+
+// Records come back as written, ordered by arrival; a cut tail is dropped,
+// a status no writer produces is rejected
+void TestQueryLogRoundTrip() {
+    using namespace std::chrono;
+    TemporaryFile log_file("query_log"s);
+    {
+        QueryLogWriter writer(log_file.GetPath());
+        writer.Write(microseconds(30), "white cat"s, DocumentStatus::BANNED, {{3, 0.5, 1}, {1, 0.25, 2}});
+        writer.Write(microseconds(10), ""s, std::nullopt, {});
+        writer.Write(microseconds(20), "-dog +cat"s, DocumentStatus::REMOVED, {{7, 1.0, 0}});
+        writer.Write(microseconds(20), "cat*"s, DocumentStatus::ACTUAL, {});
+    }
+    const std::vector<QueryLogRecord> records = ReadQueryLog(log_file.GetPath());
+    ASSERT_EQUAL(records.size(), 4u);
+    ASSERT(records[0].arrival == microseconds(10));
+    ASSERT_EQUAL(records[0].raw_query, ""s);
+    ASSERT(!records[0].status.has_value());
+    ASSERT(records[0].document_ids.empty());
+    ASSERT_EQUAL(records[1].raw_query, "-dog +cat"s);
+    ASSERT(records[1].status == DocumentStatus::REMOVED);
+    ASSERT_EQUAL(records[1].document_ids, std::vector<int>{7});
+    ASSERT_EQUAL(records[2].raw_query, "cat*"s);
+    ASSERT(records[2].status == DocumentStatus::ACTUAL);
+    ASSERT(records[3].arrival == microseconds(30));
+    ASSERT_EQUAL(records[3].raw_query, "white cat"s);
+    ASSERT(records[3].status == DocumentStatus::BANNED);
+    ASSERT_EQUAL(records[3].document_ids, (std::vector<int>{3, 1}));
+
+    std::string contents;
+    {
+        std::ifstream file(log_file.GetPath(), std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    const auto rewrite = [&log_file](const std::string &data) {
+        std::ofstream file(log_file.GetPath(), std::ios::binary | std::ios::trunc);
+        file << data;
+    };
+    rewrite(contents.substr(0, contents.size() - 2));
+    ASSERT_EQUAL(ReadQueryLog(log_file.GetPath()).size(), 3u);
+
+    // Magic and version, arrival and query size, then the query
+    const std::size_t status_offset = 4 + 4 + 8 + 4 + "white cat"s.size();
+    ASSERT_EQUAL(static_cast<int>(contents[status_offset]), static_cast<int>(DocumentStatus::BANNED));
+    for (const unsigned char status : {4, 0x7F, 0xFE}) {
+        std::string corrupt = contents;
+        corrupt[status_offset] = static_cast<char>(status);
+        rewrite(corrupt);
+        bool is_rejected = false;
+        try {
+            ReadQueryLog(log_file.GetPath());
+        } catch (const std::invalid_argument &) {
+            is_rejected = true;
+        }
+        ASSERT_HINT(is_rejected, std::to_string(status));
+    }
+    contents[status_offset] = static_cast<char>(0xFF);
+    rewrite(contents);
+    ASSERT(!ReadQueryLog(log_file.GetPath())[3].status.has_value());
+}
+
+// Loading a file must build the index that adding its lines one by one
+// does, whatever the chunk size and however many tokenizers there are
+void TestLoadCorpusMatchesAddedDocuments() {
+    SearchServer expected_server("and w3"s);
+    std::string corpus;
+    std::uint32_t seed = 1;
+    for (int id = 0; id < 600; ++id) {
+        const auto status = static_cast<DocumentStatus>(id % 7 == 0 ? id % 4 : 0);
+        const std::vector<int> ratings =
+            id % 5 == 0 ? std::vector<int>{} : std::vector<int>{id, -id / 2, 3};
+        const std::string text = MakeTestDocument(seed, 1 + id % 10) + (id % 3 == 0 ? " and"s : ""s);
+        expected_server.AddDocument(id, text, status, ratings);
+        corpus += std::to_string(id) + " "s + std::to_string(static_cast<int>(status)) + " "s;
+        if (ratings.empty()) {
+            corpus += "-"s;
+        }
+        for (std::size_t i = 0; i < ratings.size(); ++i) {
+            corpus += (i > 0 ? ","s : ""s) + std::to_string(ratings[i]);
+        }
+        corpus += " "s + text + (id % 11 == 0 ? "\r\n"s : "\n"s) + (id % 13 == 0 ? "\n"s : ""s);
+    }
+    // The last line may lack its line end
+    corpus.pop_back();
+
+    TemporaryFile corpus_file("corpus"s);
+    const auto write_corpus = [&corpus_file](const std::string &data) {
+        std::ofstream file(corpus_file.GetPath(), std::ios::binary | std::ios::trunc);
+        file << data;
+    };
+    const auto assert_same_index = [&expected_server](const SearchServer &search_server, const std::string &hint) {
+        ASSERT_EQUAL_HINT(search_server.GetDocumentCount(), expected_server.GetDocumentCount(), hint);
+        for (const std::string &query : TEST_QUERIES) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                AssertSameDocuments(search_server.FindTopDocuments(query, status),
+                                    expected_server.FindTopDocuments(query, status), hint + ": "s + query);
+            }
+        }
+        for (const int document_id : expected_server) {
+            ASSERT_HINT(search_server.MatchDocument("w0 w1 w2 w3 w10 and"s, document_id) ==
+                            expected_server.MatchDocument("w0 w1 w2 w3 w10 and"s, document_id),
+                        hint + ": "s + std::to_string(document_id));
+        }
+    };
+
+    write_corpus(corpus);
+    // Chunks of a few bytes are cut at the end of nearly every line, the
+    // others inside lines, and the largest holds the whole file
+    for (const std::size_t chunk_size : {std::size_t{1}, std::size_t{37}, std::size_t{1000}, std::size_t{1} << 20}) {
+        for (const std::size_t thread_count : {std::size_t{1}, std::size_t{3}}) {
+            SearchServer search_server("and w3"s);
+            CorpusLoaderOptions options;
+            options.chunk_size = chunk_size;
+            options.tokenizer_thread_count = thread_count;
+            options.queue_capacity = 2;
+            const CorpusLoadStats stats = LoadCorpus(search_server, corpus_file.GetPath(), options);
+            const std::string hint = "chunk "s + std::to_string(chunk_size) + ", threads "s + std::to_string(thread_count);
+            ASSERT_EQUAL_HINT(stats.document_count, 600u, hint);
+            ASSERT_EQUAL_HINT(stats.byte_count, corpus.size(), hint);
+            assert_same_index(search_server, hint);
+        }
+    }
+
+    write_corpus(""s);
+    {
+        SearchServer search_server(""s);
+        ASSERT_EQUAL(LoadCorpus(search_server, corpus_file.GetPath()).document_count, 0u);
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 0);
+    }
+
+    // Lines before a malformed one stay added, in file order
+    for (const std::string &bad_line : {"x 0 - text"s, "7 9 - text"s, "8 0 1,a text"s, "0 0 - duplicate id"s}) {
+        std::string corrupt;
+        std::size_t line_begin = 0;
+        for (int line = 0; line < 300; ++line) {
+            line_begin = corpus.find('\n', line_begin) + 1;
+            if (corpus[line_begin] == '\n') {
+                ++line_begin;
+            }
+        }
+        corrupt = corpus.substr(0, line_begin) + bad_line + "\n"s + corpus.substr(line_begin);
+        write_corpus(corrupt);
+        SearchServer search_server(""s);
+        CorpusLoaderOptions options;
+        options.chunk_size = 64;
+        options.tokenizer_thread_count = 3;
+        bool is_rejected = false;
+        try {
+            LoadCorpus(search_server, corpus_file.GetPath(), options);
+        } catch (const std::invalid_argument &) {
+            is_rejected = true;
+        }
+        ASSERT_HINT(is_rejected, bad_line);
+        ASSERT_EQUAL_HINT(search_server.GetDocumentCount(), 300, bad_line);
+        ASSERT_HINT(search_server.begin() != search_server.end() && *std::prev(search_server.end()) == 299,
+                    bad_line);
+    }
+
+    bool is_missing = false;
+    try {
+        SearchServer search_server(""s);
+        LoadCorpus(search_server, corpus_file.GetPath() + ".missing"s);
+    } catch (const std::system_error &) {
+        is_missing = true;
+    }
+    ASSERT(is_missing);
+}
+
+// Client side of one QueryServer connection; every call fails the test
+// instead of blocking for more than a few seconds
+class TestConnection {
+   public:
+    // A small receive_buffer_size makes responses back up on the server
+    explicit TestConnection(std::uint16_t port, int receive_buffer_size = 0)
+        : fd_(socket(AF_INET, SOCK_STREAM, 0)) {
+        ASSERT(fd_ >= 0);
+        const timeval timeout{5, 0};
+        setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (receive_buffer_size > 0) {
+            setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &receive_buffer_size, sizeof(receive_buffer_size));
+        }
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        ASSERT(connect(fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+    }
+
+    TestConnection(const TestConnection &) = delete;
+    TestConnection &operator=(const TestConnection &) = delete;
+
+    ~TestConnection() { close(fd_); }
+
+    void Send(const std::string &data) {
+        std::size_t sent = 0;
+        while (sent < data.size()) {
+            const ssize_t size = send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            ASSERT(size > 0);
+            sent += static_cast<std::size_t>(size);
+        }
+    }
+
+    std::string ReadLine() {
+        std::size_t line_end;
+        while ((line_end = input_.find('\n')) == std::string::npos) {
+            char buffer[4096];
+            const ssize_t size = recv(fd_, buffer, sizeof(buffer), 0);
+            ASSERT_HINT(size > 0, "connection closed or timed out"s);
+            input_.append(buffer, static_cast<std::size_t>(size));
+        }
+        std::string line = input_.substr(0, line_end);
+        input_.erase(0, line_end + 1);
+        return line;
+    }
+
+   private:
+    int fd_;
+    std::string input_;
+};
+
+// Pipelined requests are answered in order, writes are seen by the reads
+// queued after them
+void TestQueryServerProtocol() {
+    {
+        SearchServer search_server(""s);
+        QueryServerOptions options;
+        options.bind_address = "localhost"s;
+        bool is_rejected = false;
+        try {
+            QueryServer query_server(search_server, options);
+        } catch (const std::invalid_argument &) {
+            is_rejected = true;
+        }
+        ASSERT(is_rejected);
+    }
+
+    SearchServer search_server(""s);
+    QueryServerOptions options;
+    options.io_thread_count = 1;
+    // Small enough to pause reading on every other response
+    options.max_output_size = 64;
+    // One read chunk of requests must not overflow the queue
+    options.queue_capacity = 1 << 20;
+    QueryServer query_server(search_server, options);
+    std::thread server_thread([&query_server] { query_server.Run(); });
+
+    {
+        TestConnection connection(query_server.GetPort(), 4096);
+        connection.Send("ADD 1 0 5,7 white cat\n"
+                        "ADD 2 2 - black dog\r\n"
+                        "\n"
+                        "SEARCH cat\n"
+                        "MATCH 1 white dog\n"
+                        "MATCH 2 -black dog\n"
+                        "REMOVE 1\n"
+                        "SEARCH cat\n"
+                        "FETCH 1\n"
+                        "ADD x 0 - text\n"
+                        "SEARCH cat*\n"s);
+        ASSERT_EQUAL(connection.ReadLine(), "OK"s);
+        ASSERT_EQUAL(connection.ReadLine(), "OK"s);
+        ASSERT_EQUAL(connection.ReadLine(), "OK 1 1:0.346574:6"s);
+        ASSERT_EQUAL(connection.ReadLine(), "OK 0 white"s);
+        ASSERT_EQUAL(connection.ReadLine(), "OK 2"s);
+        ASSERT_EQUAL(connection.ReadLine(), "OK"s);
+        ASSERT_EQUAL(connection.ReadLine(), "OK 0"s);
+        ASSERT_EQUAL(connection.ReadLine(), "ERR Unknown command FETCH"s);
+        ASSERT_EQUAL(connection.ReadLine().substr(0, 4), "ERR "s);
+        ASSERT_EQUAL(connection.ReadLine(), "OK 0"s);
+
+        // Several read chunks of requests, far more responses than the
+        // output cap. Sending is on its own thread: the server stops
+        // reading until responses are taken.
+        std::string requests = "ADD 4 0 3 red cat\n"s;
+        for (int i = 0; i < 200000; ++i) {
+            requests += i % 2 == 0 ? "SEARCH cat\n"s : "MATCH 4 red\n"s;
+        }
+        std::thread sender([&connection, &requests] { connection.Send(requests); });
+        ASSERT_EQUAL(connection.ReadLine(), "OK"s);
+        std::this_thread::sleep_for(100ms);
+        for (int i = 0; i < 200000; ++i) {
+            ASSERT_EQUAL_HINT(connection.ReadLine(), i % 2 == 0 ? "OK 1 4:0.346574:3"s : "OK 0 red"s,
+                              std::to_string(i));
+        }
+        sender.join();
+    }
+
+    query_server.Stop();
+    server_thread.join();
+}
+
+}  // namespace
+
+void TestSearchServer() {
+    RUN_TEST(TestScoringKernelsRankIdentically);
+    RUN_TEST(TestSparseScoringMatchesDense);
+    RUN_TEST(TestCompactionUnderChurn);
+    RUN_TEST(TestPreCancelledSearch);
+    RUN_TEST(TestDeadlineExpiresMidQuery);
+    RUN_TEST(TestAsyncSearchCancellation);
+    RUN_TEST(TestQuerySyntaxFallsBackToLiteralWords);
+    RUN_TEST(TestExpansionSkipsRemovedWords);
+    RUN_TEST(TestShardedExpansionMatchesSingleServer);
+    RUN_TEST(TestShardCountDoesNotChangeResults);
+    RUN_TEST(TestCopyAndMoveShareTermDictionary);
+    RUN_TEST(TestFiltersMatchEquivalentPredicates);
+    RUN_TEST(TestPreparedQueryReuseAndInvalidation);
+    RUN_TEST(TestPostingListSeek);
+    RUN_TEST(TestRequiredWordsMatchFilteredDisjunction);
+    RUN_TEST(TestQueryServerProtocol);
+    RUN_TEST(TestParallelRemoveKeepsResourceOnCallingThread);
+    RUN_TEST(TestQueryLogRoundTrip);
+    RUN_TEST(TestLoadCorpusMatchesAddedDocuments);
+}
@@ -1,10 +1,68 @@
 #pragma once
 
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
 #include "search_server.h"
+#include "sharded_search_server.h"
 
 void AddDocument(SearchServer &search_server, int document_id, const std::string &document, DocumentStatus status,
                  const std::vector<int> &ratings);
 
 void FindTopDocuments(const SearchServer &search_server, const std::string &raw_query);
 
-//void MatchDocuments(const SearchServer &search_server, const std::string &query);
\ No newline at end of file
+//void MatchDocuments(const SearchServer &search_server, const std::string &query);
+
+template <typename Element>
+std::ostream &operator<<(std::ostream &out, const std::vector<Element> &container) {
+    out << '[';
+    bool is_first = true;
+    for (const Element &element : container) {
+        if (!is_first) {
+            out << ", "s;
+        }
+        out << element;
+        is_first = false;
+    }
+    return out << ']';
+}
+
+template <typename T, typename U>
+void AssertEqualImpl(const T &t, const U &u, const std::string &t_str, const std::string &u_str,
+                     const std::string &file, const std::string &func, unsigned line, const std::string &hint) {
+    if (t != u) {
+        std::cerr << std::boolalpha;
+        std::cerr << file << "("s << line << "): "s << func << ": "s;
+        std::cerr << "ASSERT_EQUAL("s << t_str << ", "s << u_str << ") failed: "s;
+        std::cerr << t << " != "s << u << "."s;
+        if (!hint.empty()) {
+            std::cerr << " Hint: "s << hint;
+        }
+        std::cerr << std::endl;
+        std::abort();
+    }
+}
+
+#define ASSERT_EQUAL(a, b) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, ""s)
+
+#define ASSERT_EQUAL_HINT(a, b, hint) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+void AssertImpl(bool value, const std::string &expr_str, const std::string &file, const std::string &func,
+                unsigned line, const std::string &hint);
+
+#define ASSERT(expr) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, ""s)
+
+#define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+template <typename TestFunc>
+void RunTestImpl(const TestFunc &func, const std::string &test_name) {
+    func();
+    std::cerr << test_name << " OK"s << std::endl;
+}
+
+#define RUN_TEST(func) RunTestImpl(func, #func)
+
+// Runs every test; a failed assertion aborts
+void TestSearchServer();